@@ -5,16 +5,16 @@ in vec2 TexCoords;
 
 uniform sampler2D scene;
 uniform sampler2D bloomBlur;
-uniform bool bloom;
 uniform float exposure;
 
 void main()
 {             
     const float gamma = 2.2;
     vec3 hdrColor = texture(scene, TexCoords).rgb;      
+#ifdef BLOOM
     vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
-    if(bloom)
-        hdrColor += bloomColor; // additive blending
+    hdrColor += bloomColor; // additive blending
+#endif
     // tone mapping
     vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
     // also gamma correct while we're at it       
@@ -28,23 +28,33 @@ uniform sampler2D shadowMap;
 
 const int NR_LIGHTS = 4;
 
-uniform Light lights[NR_LIGHTS];
-uniform DirectionalLight directional_light;
-uniform vec3 viewPos;
-uniform mat4 lightSpaceMatrix;
+// per frame, see FrameUniformBuffer.h
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    mat4 light_space_matrix;
+    vec3 view_position;
+};
+
+layout (std140) uniform LightData {
+    Light lights[NR_LIGHTS];
+    DirectionalLight directional_light;
+};
 
-uniform int shadows_enabled;
-uniform int specular_enabled;
+// features are #defines of the variant, see ShaderPermutations.h: SHADOWS, SPECULAR, DEBUG_VIEW
 uniform float bloom_threshold;
 
+#ifdef DEBUG_VIEW
+// 1 normals, 2 albedo, 3 positions, 4 depth
 uniform int show_render_target;
+#endif
 
 float ShadowCalculation(vec4 fragPosLightSpace, vec3 Normal, vec3 FragPos)
 {
-    if(shadows_enabled == 0) {
-        return 1.0;
-    }
-
+#ifndef SHADOWS
+    return 1.0;
+#else
     // perform perspective divide
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     // transform to [0,1] range
@@ -78,6 +88,7 @@ float ShadowCalculation(vec4 fragPosLightSpace, vec3 Normal, vec3 FragPos)
     }
         
     return shadow;
+#endif
 }  
 
 vec3 directional_light_influence(DirectionalLight light_source, vec3 normal, vec3 camera_direction, vec3 diffuse_value, float spec_value, float shadow) {
@@ -92,14 +103,12 @@ vec3 directional_light_influence(DirectionalLight light_source, vec3 normal, vec
     vec3 diffuse = light_source.diffuse * diffuse_factor * diffuse_value;
     vec3 specular = light_source.specular * specular_factor * spec_value;
 
-    if(specular_enabled == 0) {
-        vec3 lighting = (ambient + (1.0 - shadow) * diffuse) * diffuse_value;
-        return lighting;
-    }
-    else {
-        vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * diffuse_value;
-        return lighting;
-    }
+#ifdef SPECULAR
+    vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * diffuse_value;
+#else
+    vec3 lighting = (ambient + (1.0 - shadow) * diffuse) * diffuse_value;
+#endif
+    return lighting;
 }
 
 void main() {
@@ -108,11 +117,10 @@ void main() {
     vec3 Normal = texture(gNormal, texture_coords).rgb;
     vec3 Diffuse = texture(gAlbedoSpec, texture_coords).rgb;
     float Specular = texture(gAlbedoSpec, texture_coords).a;
-    float Depth = texture(gDepth, texture_coords).x;
 
     //vec3 lighting  = Diffuse * 0.1; // hard-coded ambient component
-    vec3 viewDir  = normalize(viewPos - FragPos);
-    vec4 pos_to_dir_light = lightSpaceMatrix * vec4(FragPos, 1.0);
+    vec3 viewDir  = normalize(view_position - FragPos);
+    vec4 pos_to_dir_light = light_space_matrix * vec4(FragPos, 1.0);
     float shadow = ShadowCalculation(pos_to_dir_light, Normal, FragPos);
     vec3 dir_light_inf = directional_light_influence(directional_light, Normal, viewDir, Diffuse, Specular, shadow);
     vec3 lighting = dir_light_inf;
@@ -136,16 +144,8 @@ void main() {
         }
     }*/
 
-    if(show_render_target == 0) {
-        out_col = vec4(lighting, 1.0);
-        if(length(out_col.rgb) > bloom_threshold) {
-            bright_col = out_col;
-        }
-        else {
-            bright_col = vec4(0.0, 0.0, 0.0, 1.0);
-        }
-    }
-    else if(show_render_target == 1) {
+#ifdef DEBUG_VIEW
+    if(show_render_target == 1) {
         out_col = vec4(Normal, 1.0);
     }
     else if(show_render_target == 2) {
@@ -154,7 +154,18 @@ void main() {
     else if(show_render_target == 3) {
         out_col = vec4(FragPos, 1.0);
     }
-    else if(show_render_target == 4) {
+    else {
+        float Depth = texture(gDepth, texture_coords).x;
         out_col = vec4(Depth, Depth, Depth, 1.0);
     }
+    bright_col = vec4(0.0, 0.0, 0.0, 1.0);
+#else
+    out_col = vec4(lighting, 1.0);
+    if(length(out_col.rgb) > bloom_threshold) {
+        bright_col = out_col;
+    }
+    else {
+        bright_col = vec4(0.0, 0.0, 0.0, 1.0);
+    }
+#endif
 }
\ No newline at end of file
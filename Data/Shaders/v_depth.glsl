@@ -1,10 +1,18 @@
 #version 330 core
 layout (location = 0) in vec3 in_pos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per object, computed on the CPU, see TransformBuffer.h
+layout (std140) uniform ObjectTransform {
+    mat4 object_model;
+    mat3 object_normal;
+    mat4 object_model_view_projection;
+};
+
+// decodes the vertex format the mesh was uploaded with, see VertexLayout.h
+uniform vec3 vertex_position_offset;
+uniform vec3 vertex_position_scale;
 
 void main() {
-    gl_Position = projection * view * model * vec4(in_pos, 1.0);
+    vec3 position = in_pos * vertex_position_scale + vertex_position_offset;
+    gl_Position = object_model_view_projection * vec4(position, 1.0);
 }
@@ -7,17 +7,37 @@ out vec3 fragment_position;
 out vec2 texture_coords;
 out vec3 normal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per object, computed on the CPU, see TransformBuffer.h
+layout (std140) uniform ObjectTransform {
+    mat4 object_model;
+    mat3 object_normal;
+    mat4 object_model_view_projection;
+};
+
+// decodes the vertex format the mesh was uploaded with, see VertexLayout.h
+uniform vec3 vertex_position_offset;
+uniform vec3 vertex_position_scale;
+uniform bool vertex_octahedral_normals;
+
+vec3 decode_normal(vec3 encoded) {
+    if (!vertex_octahedral_normals) {
+        return encoded;
+    }
+    vec3 n = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main() {
-    vec4 world_position = model * vec4(v_in_pos, 1.0);
+    vec3 position = v_in_pos * vertex_position_scale + vertex_position_offset;
+    vec3 decoded_normal = decode_normal(v_in_normal);
+    vec4 world_position = object_model * vec4(position, 1.0);
     fragment_position = world_position.xyz; 
     texture_coords = v_in_texture_coords;
     
-    mat3 normal_matrix = transpose(inverse(mat3(model)));
-    normal = normal_matrix * v_in_normal;
+    normal = object_normal * decoded_normal;
 
-    gl_Position = projection * view * world_position;
+    gl_Position = object_model_view_projection * vec4(position, 1.0);
 }
@@ -0,0 +1,48 @@
+#version 330 core
+layout (location = 0) in vec3 v_in_pos;
+layout (location = 1) in vec3 v_in_normal;
+layout (location = 2) in vec2 v_in_texture_coords;
+// per instance, see InstanceBuffer.h
+layout (location = 3) in mat4 v_in_model;
+layout (location = 7) in mat3 v_in_normal_matrix;
+
+out vec3 fragment_position;
+out vec2 texture_coords;
+out vec3 normal;
+
+// per frame, see FrameUniformBuffer.h
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    mat4 light_space_matrix;
+    vec3 view_position;
+};
+
+// decodes the vertex format the mesh was uploaded with, see VertexLayout.h
+uniform vec3 vertex_position_offset;
+uniform vec3 vertex_position_scale;
+uniform bool vertex_octahedral_normals;
+
+vec3 decode_normal(vec3 encoded) {
+    if (!vertex_octahedral_normals) {
+        return encoded;
+    }
+    vec3 n = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main() {
+    vec3 position = v_in_pos * vertex_position_scale + vertex_position_offset;
+    vec3 decoded_normal = decode_normal(v_in_normal);
+    vec4 world_position = v_in_model * vec4(position, 1.0);
+    fragment_position = world_position.xyz; 
+    texture_coords = v_in_texture_coords;
+    
+    normal = v_in_normal_matrix * decoded_normal;
+
+    gl_Position = view_projection * world_position;
+}
@@ -1,10 +1,13 @@
 #version 330 core
 layout (location = 0) in vec3 in_pos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per object, computed on the CPU, see TransformBuffer.h
+layout (std140) uniform ObjectTransform {
+	mat4 object_model;
+	mat3 object_normal;
+	mat4 object_model_view_projection;
+};
 
 void main() {
-	gl_Position = projection * view * model * vec4(in_pos, 1.0);
+	gl_Position = object_model_view_projection * vec4(in_pos, 1.0);
 }
\ No newline at end of file
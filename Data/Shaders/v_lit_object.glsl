@@ -7,21 +7,42 @@ out vec2 texture_coords;
 out vec3 vertex_normal;
 out vec3 vertex_world_position;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per object, computed on the CPU, see TransformBuffer.h
+layout (std140) uniform ObjectTransform {
+	mat4 object_model;
+	mat3 object_normal;
+	mat4 object_model_view_projection;
+};
+
+// decodes the vertex format the mesh was uploaded with, see VertexLayout.h
+uniform vec3 vertex_position_offset;
+uniform vec3 vertex_position_scale;
+uniform bool vertex_octahedral_normals;
+
+vec3 decode_normal(vec3 encoded) {
+	if (!vertex_octahedral_normals) {
+		return encoded;
+	}
+	vec3 n = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
 
 void main() {
-	vertex_normal = mat3(transpose(inverse(model))) * normalize(in_normal);
+	vec3 position = in_pos * vertex_position_scale + vertex_position_offset;
+	vec3 decoded_normal = decode_normal(in_normal);
+	vertex_normal = object_normal * normalize(decoded_normal);
 	
-	vec4 pos_vec4 = vec4(in_pos, 1.0);
+	vec4 pos_vec4 = vec4(position, 1.0);
 
 	// vec3 version for diffuse lighting, vec4 version for the mvp
-	vec4 world_position = model * pos_vec4;
+	vec4 world_position = object_model * pos_vec4;
 	vertex_world_position = vec3(world_position);
 
 	// set texture coordinates
 	texture_coords = in_tex_coords;
 
-	gl_Position = projection * view * world_position;
+	gl_Position = object_model_view_projection * pos_vec4;
 }
\ No newline at end of file
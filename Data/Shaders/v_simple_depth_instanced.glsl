@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+// per instance, see InstanceBuffer.h
+layout (location = 3) in mat4 v_in_model;
+
+// per frame, see FrameUniformBuffer.h
+layout (std140) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 view_projection;
+	mat4 light_space_matrix;
+	vec3 view_position;
+};
+
+// decodes the vertex format the mesh was uploaded with, see VertexLayout.h
+uniform vec3 vertex_position_offset;
+uniform vec3 vertex_position_scale;
+
+void main() {
+	vec3 position = aPos * vertex_position_scale + vertex_position_offset;
+	gl_Position = light_space_matrix * v_in_model * vec4(position, 1.0);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct BoundingBox {
+	glm::vec3 Min = glm::vec3(0.0f);
+	glm::vec3 Max = glm::vec3(0.0f);
+
+	glm::vec3 GetCenter() const {
+		return (Min + Max) * 0.5f;
+	}
+
+	// box around the transformed box (Arvo's method)
+	BoundingBox Transform(const glm::mat4& matrix) const {
+		glm::vec3 translation = glm::vec3(matrix[3]);
+		BoundingBox result;
+		result.Min = translation;
+		result.Max = translation;
+		for (int column = 0; column < 3; column++) {
+			for (int row = 0; row < 3; row++) {
+				float a = matrix[column][row] * Min[column];
+				float b = matrix[column][row] * Max[column];
+				result.Min[row] += std::min(a, b);
+				result.Max[row] += std::max(a, b);
+			}
+		}
+		return result;
+	}
+
+	void Merge(const BoundingBox& other) {
+		Min = glm::min(Min, other.Min);
+		Max = glm::max(Max, other.Max);
+	}
+};
+
+struct BoundingSphere {
+	glm::vec3 Center = glm::vec3(0.0f);
+	float Radius = 0.0f;
+
+	// radius grows with the largest axis scale of the matrix
+	BoundingSphere Transform(const glm::mat4& matrix) const {
+		float scale = std::sqrt(std::max(std::max(glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0])),
+			glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1]))),
+			glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]))));
+
+		BoundingSphere result;
+		result.Center = glm::vec3(matrix * glm::vec4(Center, 1.0f));
+		result.Radius = Radius * scale;
+		return result;
+	}
+};
+
+struct Bounds {
+	BoundingBox Box;
+	BoundingSphere Sphere;
+
+	template <typename T, typename GetPosition>
+	static Bounds FromPoints(const std::vector<T>& points, GetPosition get_position) {
+		Bounds bounds;
+		if (points.empty()) {
+			return bounds;
+		}
+
+		bounds.Box.Min = get_position(points[0]);
+		bounds.Box.Max = bounds.Box.Min;
+		for (const T& point : points) {
+			bounds.Box.Min = glm::min(bounds.Box.Min, get_position(point));
+			bounds.Box.Max = glm::max(bounds.Box.Max, get_position(point));
+		}
+
+		// centered on the box, radius reaches the farthest point instead of the box corner
+		bounds.Sphere.Center = bounds.Box.GetCenter();
+		float radius_squared = 0.0f;
+		for (const T& point : points) {
+			glm::vec3 offset = get_position(point) - bounds.Sphere.Center;
+			radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+		}
+		bounds.Sphere.Radius = std::sqrt(radius_squared);
+
+		return bounds;
+	}
+};
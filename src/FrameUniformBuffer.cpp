@@ -0,0 +1,99 @@
+#include "FrameUniformBuffer.h"
+
+#include <cstring>
+
+static_assert(sizeof(glm::vec3) == 12, "std140 packing below assumes tightly packed vectors");
+
+static size_t AlignUp(size_t size, size_t alignment) {
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+FrameUniformBuffer::FrameUniformBuffer() : _ubo(0), _slice(0), _is_slice_used(false), _frame_data(), _light_data() {
+	static_assert(sizeof(PointLight) == 48, "a Light takes three vec4 slots in std140");
+	static_assert(sizeof(LightData) == MAX_POINT_LIGHTS * 48 + 64, "LightData has to match the std140 block");
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment < 16) {
+		alignment = 16;
+	}
+	_light_offset = AlignUp(sizeof(FrameData), alignment);
+	_slice_size = AlignUp(_light_offset + sizeof(LightData), alignment);
+
+	for (unsigned int i = 0; i < SLICE_COUNT; i++) {
+		_fences[i] = 0;
+	}
+
+	glGenBuffers(1, &_ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+	glBufferData(GL_UNIFORM_BUFFER, _slice_size * SLICE_COUNT, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+FrameUniformBuffer::~FrameUniformBuffer() {
+	for (unsigned int i = 0; i < SLICE_COUNT; i++) {
+		if (_fences[i] != 0) {
+			glDeleteSync(_fences[i]);
+		}
+	}
+	glDeleteBuffers(1, &_ubo);
+}
+
+void FrameUniformBuffer::SetCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position) {
+	_frame_data.View = view;
+	_frame_data.Projection = projection;
+	_frame_data.ViewProjection = projection * view;
+	_frame_data.ViewPosition = glm::vec4(position, 1.0f);
+}
+
+void FrameUniformBuffer::SetLightSpace(const glm::mat4& light_space) {
+	_frame_data.LightSpace = light_space;
+}
+
+void FrameUniformBuffer::SetDirectionalLight(const glm::vec3& direction, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular) {
+	_light_data.Directional.Direction = glm::vec4(direction, 0.0f);
+	_light_data.Directional.Ambient = glm::vec4(ambient, 0.0f);
+	_light_data.Directional.Diffuse = glm::vec4(diffuse, 0.0f);
+	_light_data.Directional.Specular = glm::vec4(specular, 0.0f);
+}
+
+void FrameUniformBuffer::SetPointLight(unsigned int index, const glm::vec3& position, const glm::vec3& color, float linear, float quadratic, float radius) {
+	if (index >= MAX_POINT_LIGHTS) {
+		return;
+	}
+	PointLight& light = _light_data.PointLights[index];
+	light.Position = position;
+	light.Color = color;
+	light.Linear = linear;
+	light.Quadratic = quadratic;
+	light.Radius = radius;
+}
+
+void FrameUniformBuffer::Upload() {
+	// everything of the last frame is submitted by now, including the draws that read its slice
+	if (_is_slice_used) {
+		_fences[_slice] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	_slice = (_slice + 1) % SLICE_COUNT;
+	_is_slice_used = true;
+	size_t offset = _slice * _slice_size;
+
+	// normally signalled long ago, a GPU more than SLICE_COUNT frames behind makes the CPU wait here
+	if (_fences[_slice] != 0) {
+		glClientWaitSync(_fences[_slice], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(_fences[_slice]);
+		_fences[_slice] = 0;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+	unsigned char* slice = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, offset, _slice_size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (slice != nullptr) {
+		std::memcpy(slice, &_frame_data, sizeof(FrameData));
+		std::memcpy(slice + _light_offset, &_light_data, sizeof(LightData));
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BINDING, _ubo, offset, sizeof(FrameData));
+	glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_BINDING, _ubo, offset + _light_offset, sizeof(LightData));
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Camera and lighting state every program shares, in the FrameData and LightData uniform blocks. Both are filled
+// on the CPU through the frame's setters, then written with a single buffer update into the next slice of a ring
+// of slices in one uniform buffer and bound to fixed binding points, where they stay for the whole frame.
+// A slice is only rewritten once the fence of the frame that last used it has signalled.
+// The destructor deletes the fences and the uniform buffer with all slices, it runs before the context goes.
+class FrameUniformBuffer {
+public:
+	// binding points the Shader constructor assigns to every program's FrameData and LightData blocks,
+	// TransformBuffer::BINDING is 0
+	static const GLuint FRAME_BINDING = 1;
+	static const GLuint LIGHT_BINDING = 2;
+	// NR_LIGHTS of the shaders
+	static const unsigned int MAX_POINT_LIGHTS = 4;
+	// frames the GPU may be behind before Upload waits
+	static const unsigned int SLICE_COUNT = 3;
+
+	FrameUniformBuffer();
+	FrameUniformBuffer(const FrameUniformBuffer&) = delete;
+	FrameUniformBuffer& operator=(const FrameUniformBuffer&) = delete;
+	~FrameUniformBuffer();
+
+	void SetCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position);
+	void SetLightSpace(const glm::mat4& light_space);
+	void SetDirectionalLight(const glm::vec3& direction, const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular);
+	void SetPointLight(unsigned int index, const glm::vec3& position, const glm::vec3& color, float linear, float quadratic, float radius);
+
+	// writes both blocks and binds them, once per frame after the setters
+	void Upload();
+
+private:
+	// std140 layouts, a vec3 takes a vec4 slot unless a float follows it
+	struct FrameData {
+		glm::mat4 View;
+		glm::mat4 Projection;
+		glm::mat4 ViewProjection;
+		// the shadow map's camera
+		glm::mat4 LightSpace;
+		glm::vec4 ViewPosition;
+	};
+
+	struct PointLight {
+		glm::vec3 Position;
+		float Padding0;
+		glm::vec3 Color;
+		float Linear;
+		float Quadratic;
+		float Radius;
+		float Padding1[2];
+	};
+
+	struct DirectionalLight {
+		glm::vec4 Direction;
+		glm::vec4 Ambient;
+		glm::vec4 Diffuse;
+		glm::vec4 Specular;
+	};
+
+	struct LightData {
+		PointLight PointLights[MAX_POINT_LIGHTS];
+		DirectionalLight Directional;
+	};
+
+	unsigned int _ubo;
+	// LightData follows FrameData in a slice, both at the uniform buffer offset alignment
+	size_t _light_offset;
+	size_t _slice_size;
+	unsigned int _slice;
+	// false until the first Upload, there is no frame before it to fence
+	bool _is_slice_used;
+	// per slice, signalled once the frame that read it has finished
+	GLsync _fences[SLICE_COUNT];
+
+	FrameData _frame_data;
+	LightData _light_data;
+};
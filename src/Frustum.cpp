@@ -0,0 +1,89 @@
+#include "Frustum.h"
+
+Frustum::Frustum() {
+	// accepts everything
+	for (int i = 0; i < 6; i++) {
+		_planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+Frustum::Frustum(const glm::mat4& view_projection) {
+	// Gribb / Hartmann plane extraction, glm matrices are indexed [column][row]
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; row++) {
+		rows[row] = glm::vec4(view_projection[0][row], view_projection[1][row], view_projection[2][row], view_projection[3][row]);
+	}
+
+	_planes[0] = rows[3] + rows[0]; // left
+	_planes[1] = rows[3] - rows[0]; // right
+	_planes[2] = rows[3] + rows[1]; // bottom
+	_planes[3] = rows[3] - rows[1]; // top
+	_planes[4] = rows[3] + rows[2]; // near
+	_planes[5] = rows[3] - rows[2]; // far
+
+	for (int i = 0; i < 6; i++) {
+		float length = glm::length(glm::vec3(_planes[i]));
+		if (length > 0.0f) {
+			_planes[i] /= length;
+		}
+	}
+}
+
+Frustum Frustum::Transform(const glm::mat4& matrix) const {
+	// a point p is inside a world plane when dot(plane, matrix * p) >= 0, so the object plane is transpose(matrix) * plane
+	glm::mat4 transposed = glm::transpose(matrix);
+	Frustum result;
+	for (int i = 0; i < 6; i++) {
+		// the accept everything planes of the default frustum stay as they are
+		if (glm::vec3(_planes[i]) == glm::vec3(0.0f)) {
+			result._planes[i] = _planes[i];
+			continue;
+		}
+
+		result._planes[i] = transposed * _planes[i];
+		float length = glm::length(glm::vec3(result._planes[i]));
+		if (length > 0.0f) {
+			result._planes[i] /= length;
+		}
+	}
+	return result;
+}
+
+bool Frustum::Intersects(const BoundingSphere& sphere) const {
+	for (int i = 0; i < 6; i++) {
+		if (glm::dot(glm::vec3(_planes[i]), sphere.Center) + _planes[i].w < -sphere.Radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::Intersects(const BoundingBox& box) const {
+	for (int i = 0; i < 6; i++) {
+		// the corner furthest along the plane normal
+		glm::vec3 corner;
+		corner.x = _planes[i].x >= 0.0f ? box.Max.x : box.Min.x;
+		corner.y = _planes[i].y >= 0.0f ? box.Max.y : box.Min.y;
+		corner.z = _planes[i].z >= 0.0f ? box.Max.z : box.Min.z;
+		if (glm::dot(glm::vec3(_planes[i]), corner) + _planes[i].w < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+DrawView DrawView::ToObjectSpace(const glm::mat4& model_matrix) const {
+	DrawView result = *this;
+	result.ViewFrustum = ViewFrustum.Transform(model_matrix);
+	result.Position = glm::vec3(glm::inverse(model_matrix) * glm::vec4(Position, 1.0f));
+
+	// errors are measured in object units, an orthographic view covers more pixels per unit on a scaled up model.
+	// perspective views compare error against distance, which both scale alike
+	if (IsOrthographic) {
+		float scale = std::sqrt(std::max(std::max(glm::dot(glm::vec3(model_matrix[0]), glm::vec3(model_matrix[0])),
+			glm::dot(glm::vec3(model_matrix[1]), glm::vec3(model_matrix[1]))),
+			glm::dot(glm::vec3(model_matrix[2]), glm::vec3(model_matrix[2]))));
+		result.LodPixelScale = LodPixelScale * scale;
+	}
+	return result;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+// Drawn / culled counts of one pass
+struct CullingStats {
+	unsigned int Drawn = 0;
+	unsigned int Culled = 0;
+	unsigned int MeshletsCulled = 0;
+	// triangles handed to the GPU after mesh and meshlet culling
+	unsigned int Triangles = 0;
+};
+
+// The six planes of a view-projection (perspective or ortho) matrix, normals pointing inwards
+class Frustum {
+public:
+	Frustum();
+	Frustum(const glm::mat4& view_projection);
+
+	// the same frustum in the space the matrix maps from, e.g. a model matrix gives an object space frustum
+	Frustum Transform(const glm::mat4& matrix) const;
+
+	bool Intersects(const BoundingSphere& sphere) const;
+	bool Intersects(const BoundingBox& box) const;
+
+private:
+	glm::vec4 _planes[6];
+};
+
+// What a pass culls against. Meshlet cone culling needs a view position, so passes without one
+// (the ortho shadow pass) leave it off.
+struct DrawView {
+	Frustum ViewFrustum;
+	glm::vec3 Position = glm::vec3(0.0f);
+	bool MeshletCulling = true;
+	bool ConeCulling = false;
+
+	// LOD selection picks the coarsest level whose error covers at most LodErrorPixels on screen.
+	// LodPixelScale is viewport height / (2 tan(fov / 2)) for perspective views and pixels per unit for
+	// orthographic ones, 0 always draws full detail.
+	float LodPixelScale = 0.0f;
+	float LodErrorPixels = 1.0f;
+	bool IsOrthographic = false;
+
+	// frustum and position in the object space of model_matrix, so bounds can be tested untransformed
+	DrawView ToObjectSpace(const glm::mat4& model_matrix) const;
+};
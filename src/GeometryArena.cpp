@@ -0,0 +1,227 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+
+#include <GLFW/glfw3.h>
+
+// glad is generated for GL 3.3, the indirect draw path is loaded by hand
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+void DrawList::Reserve(size_t size) {
+	Counts.reserve(size);
+	Offsets.reserve(size);
+	BaseVertices.reserve(size);
+}
+
+void DrawList::Clear() {
+	Counts.clear();
+	Offsets.clear();
+	BaseVertices.clear();
+}
+
+void DrawList::Add(GLsizei count, size_t byte_offset, GLint base_vertex) {
+	Counts.push_back(count);
+	Offsets.push_back((const void*)byte_offset);
+	BaseVertices.push_back(base_vertex);
+}
+
+size_t DrawList::Size() const {
+	return Counts.size();
+}
+
+void DrawList::Submit(GLenum index_type) const {
+	if (Counts.size() == 1) {
+		glDrawElementsBaseVertex(GL_TRIANGLES, Counts[0], index_type, Offsets[0], BaseVertices[0]);
+	}
+	else if (!Counts.empty()) {
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, Counts.data(), index_type, Offsets.data(), (GLsizei)Counts.size(), BaseVertices.data());
+	}
+}
+
+GeometryArena::GeometryArena(VertexFormat format, size_t vertex_capacity, size_t index_capacity)
+	: _format(format), _vertex_stride(GetVertexStride(format)), _vao(0), _vbo(0), _ebo(0),
+	_vertex_capacity(std::max((size_t)1, vertex_capacity)), _index_capacity(std::max((size_t)1, index_capacity)), _vertex_count(0), _index_count(0),
+	_multi_draw_elements_indirect(nullptr), _is_indirect_enabled(false), _indirect_buffer(0), _indirect_cursor(0) {
+	glGenVertexArrays(1, &_vao);
+	glGenBuffers(1, &_vbo);
+	glGenBuffers(1, &_ebo);
+
+	glBindVertexArray(_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+	glBufferData(GL_ARRAY_BUFFER, _vertex_capacity * _vertex_stride, NULL, GL_STATIC_DRAW);
+	SetupVertexAttributes(_format);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, _index_capacity * sizeof(unsigned short), NULL, GL_STATIC_DRAW);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	GLint major_version = 0;
+	GLint minor_version = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major_version);
+	glGetIntegerv(GL_MINOR_VERSION, &minor_version);
+	bool has_indirect = major_version > 4 || (major_version == 4 && minor_version >= 3) || glfwExtensionSupported("GL_ARB_multi_draw_indirect");
+	if (has_indirect) {
+		_multi_draw_elements_indirect = (MultiDrawElementsIndirectProc)glfwGetProcAddress("glMultiDrawElementsIndirect");
+	}
+
+	if (_multi_draw_elements_indirect != nullptr) {
+		glGenBuffers(1, &_indirect_buffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirect_buffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, INDIRECT_COMMAND_CAPACITY * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		_commands.reserve(INDIRECT_COMMAND_CAPACITY);
+		_is_indirect_enabled = true;
+	}
+}
+
+GeometryArena::~GeometryArena() {
+	glDeleteVertexArrays(1, &_vao);
+	glDeleteBuffers(1, &_vbo);
+	glDeleteBuffers(1, &_ebo);
+	if (_indirect_buffer != 0) {
+		glDeleteBuffers(1, &_indirect_buffer);
+	}
+}
+
+GeometryArena::Allocation GeometryArena::Allocate(const void* packed_vertices, size_t vertex_bytes, const unsigned short* indices, size_t index_count,
+	UploadRing* staging) {
+	size_t vertex_count = vertex_bytes / _vertex_stride;
+	Reserve(vertex_count, index_count);
+
+	Allocation allocation;
+	allocation.BaseVertex = (unsigned int)_vertex_count;
+	allocation.FirstIndex = (unsigned int)_index_count;
+
+	if (staging != nullptr) {
+		// the buffers may grow again before the copies are issued, so staging reads the names then
+		staging->QueueBuffer(&_vbo, _vertex_count * _vertex_stride, packed_vertices, vertex_bytes);
+		staging->QueueBuffer(&_ebo, _index_count * sizeof(unsigned short), indices, index_count * sizeof(unsigned short));
+	}
+	else {
+		// copy targets so the element array binding of whatever vertex array is bound stays untouched
+		glBindBuffer(GL_COPY_WRITE_BUFFER, _vbo);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, _vertex_count * _vertex_stride, vertex_bytes, packed_vertices);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, _ebo);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, _index_count * sizeof(unsigned short), index_count * sizeof(unsigned short), indices);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	_vertex_count += vertex_count;
+	_index_count += index_count;
+	return allocation;
+}
+
+VertexFormat GeometryArena::GetFormat() const {
+	return _format;
+}
+
+void GeometryArena::Bind() const {
+	glBindVertexArray(_vao);
+}
+
+unsigned int GeometryArena::GetVertexArray() const {
+	return _vao;
+}
+
+void GeometryArena::Submit(const DrawList& list) const {
+	if (!_is_indirect_enabled || list.Size() < 2) {
+		list.Submit(GL_UNSIGNED_SHORT);
+		return;
+	}
+
+	_commands.clear();
+	for (size_t i = 0; i < list.Size(); i++) {
+		DrawElementsIndirectCommand command;
+		command.Count = list.Counts[i];
+		command.InstanceCount = 1;
+		command.FirstIndex = (GLuint)((size_t)list.Offsets[i] / sizeof(unsigned short));
+		command.BaseVertex = list.BaseVertices[i];
+		command.BaseInstance = 0;
+		_commands.push_back(command);
+	}
+
+	// lists longer than the whole buffer fall back to the direct path
+	if (_commands.size() > INDIRECT_COMMAND_CAPACITY) {
+		list.Submit(GL_UNSIGNED_SHORT);
+		return;
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirect_buffer);
+	if (_indirect_cursor + _commands.size() > INDIRECT_COMMAND_CAPACITY) {
+		// orphan instead of waiting for the GPU to finish with the commands already in the buffer
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, INDIRECT_COMMAND_CAPACITY * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+		_indirect_cursor = 0;
+	}
+
+	size_t byte_offset = _indirect_cursor * sizeof(DrawElementsIndirectCommand);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, byte_offset, _commands.size() * sizeof(DrawElementsIndirectCommand), _commands.data());
+	_multi_draw_elements_indirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (const void*)byte_offset, (GLsizei)_commands.size(), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	_indirect_cursor += _commands.size();
+}
+
+bool GeometryArena::IsIndirectSupported() const {
+	return _multi_draw_elements_indirect != nullptr;
+}
+
+void GeometryArena::SetIndirectEnabled(bool is_enabled) {
+	_is_indirect_enabled = is_enabled && IsIndirectSupported();
+}
+
+bool GeometryArena::IsIndirectEnabled() const {
+	return _is_indirect_enabled;
+}
+
+size_t GeometryArena::GetUsedBytes() const {
+	return _vertex_count * _vertex_stride + _index_count * sizeof(unsigned short);
+}
+
+size_t GeometryArena::GetCapacityBytes() const {
+	return _vertex_capacity * _vertex_stride + _index_capacity * sizeof(unsigned short);
+}
+
+void GeometryArena::Reserve(size_t vertex_count, size_t index_count) {
+	// doubling keeps the number of copies logarithmic in the scene size
+	if (_vertex_count + vertex_count > _vertex_capacity) {
+		size_t new_capacity = std::max(_vertex_capacity * 2, _vertex_count + vertex_count);
+		_vbo = GrowBuffer(_vbo, _vertex_count * _vertex_stride, new_capacity * _vertex_stride);
+		_vertex_capacity = new_capacity;
+
+		// the vertex array still points at the old buffer
+		glBindVertexArray(_vao);
+		glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+		SetupVertexAttributes(_format);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	if (_index_count + index_count > _index_capacity) {
+		size_t new_capacity = std::max(_index_capacity * 2, _index_count + index_count);
+		_ebo = GrowBuffer(_ebo, _index_count * sizeof(unsigned short), new_capacity * sizeof(unsigned short));
+		_index_capacity = new_capacity;
+
+		glBindVertexArray(_vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ebo);
+		glBindVertexArray(0);
+	}
+}
+
+unsigned int GeometryArena::GrowBuffer(unsigned int buffer, size_t used_size, size_t new_size) {
+	unsigned int new_buffer = 0;
+	glGenBuffers(1, &new_buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, new_size, NULL, GL_STATIC_DRAW);
+
+	if (used_size > 0) {
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used_size);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glDeleteBuffers(1, &buffer);
+	return new_buffer;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "UploadRing.h"
+#include "VertexLayout.h"
+
+// Index ranges that share a vertex array, material and index type and go out in one multi draw
+struct DrawList {
+	std::vector<GLsizei> Counts;
+	std::vector<const void*> Offsets;
+	std::vector<GLint> BaseVertices;
+
+	void Reserve(size_t size);
+	// keeps the capacity so refilling every frame does not allocate
+	void Clear();
+	void Add(GLsizei count, size_t byte_offset, GLint base_vertex);
+	size_t Size() const;
+
+	// one glDrawElementsBaseVertex, or glMultiDrawElementsBaseVertex for several ranges
+	void Submit(GLenum index_type) const;
+};
+
+// One vertex buffer, one 16 bit index buffer and one vertex array shared by every mesh of a vertex format.
+// Meshes suballocate their geometry and are drawn with base vertex offsets, so a pass binds the vertex
+// array once and meshes with the same material can be batched into a single multi draw.
+// Space is handed out linearly and only given back when the arena is destroyed, which fits scene
+// geometry that lives as long as the scene. The buffers and the vertex array are deleted with the arena, which has
+// to happen before the context goes, like the rest of the scene.
+class GeometryArena {
+public:
+	struct Allocation {
+		unsigned int BaseVertex;
+		unsigned int FirstIndex;
+	};
+
+	GeometryArena(VertexFormat format, size_t vertex_capacity, size_t index_capacity);
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+	~GeometryArena();
+
+	// copies packed vertices (in this arena's format) and indices local to them into the shared buffers,
+	// growing them if needed. With staging the copies are queued there instead and the data has to stay
+	// valid until they are issued.
+	Allocation Allocate(const void* packed_vertices, size_t vertex_bytes, const unsigned short* indices, size_t index_count,
+		UploadRing* staging = nullptr);
+
+	VertexFormat GetFormat() const;
+	void Bind() const;
+	unsigned int GetVertexArray() const;
+	// submits the list with glMultiDrawElementsIndirect when enabled and supported, otherwise as a base vertex multi draw
+	void Submit(const DrawList& list) const;
+
+	// GL 4.3 or ARB_multi_draw_indirect
+	bool IsIndirectSupported() const;
+	void SetIndirectEnabled(bool is_enabled);
+	bool IsIndirectEnabled() const;
+
+	size_t GetUsedBytes() const;
+	size_t GetCapacityBytes() const;
+
+private:
+	// layout of glMultiDrawElementsIndirect commands
+	struct DrawElementsIndirectCommand {
+		GLuint Count;
+		GLuint InstanceCount;
+		GLuint FirstIndex;
+		GLint BaseVertex;
+		GLuint BaseInstance;
+	};
+
+	typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect, GLsizei draw_count, GLsizei stride);
+
+	// commands the indirect buffer holds before it is orphaned and refilled from the start
+	static const unsigned int INDIRECT_COMMAND_CAPACITY = 4096;
+
+	VertexFormat _format;
+	unsigned int _vertex_stride;
+	unsigned int _vao;
+	unsigned int _vbo;
+	unsigned int _ebo;
+	size_t _vertex_capacity;
+	size_t _index_capacity;
+	size_t _vertex_count;
+	size_t _index_count;
+
+	MultiDrawElementsIndirectProc _multi_draw_elements_indirect;
+	bool _is_indirect_enabled;
+	unsigned int _indirect_buffer;
+	// commands are appended through the frame, nothing already queued is overwritten before the orphan
+	mutable size_t _indirect_cursor;
+	mutable std::vector<DrawElementsIndirectCommand> _commands;
+
+	void Reserve(size_t vertex_count, size_t index_count);
+	// moves the contents of buffer into a new buffer of new_size bytes and returns it
+	static unsigned int GrowBuffer(unsigned int buffer, size_t used_size, size_t new_size);
+};
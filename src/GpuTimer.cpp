@@ -0,0 +1,46 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer() : _current(0), _milliseconds(0.0) {
+	glGenQueries(QUERY_COUNT, _queries);
+	for (int i = 0; i < QUERY_COUNT; i++) {
+		_is_pending[i] = false;
+	}
+}
+
+GpuTimer::~GpuTimer() {
+	glDeleteQueries(QUERY_COUNT, _queries);
+}
+
+void GpuTimer::Begin() {
+	// collect whatever finished since the last frame before the slot gets reused
+	for (int i = 0; i < QUERY_COUNT; i++) {
+		int index = (_current + i) % QUERY_COUNT;
+		if (!_is_pending[index]) {
+			continue;
+		}
+
+		GLint is_available = 0;
+		glGetQueryObjectiv(_queries[index], GL_QUERY_RESULT_AVAILABLE, &is_available);
+		if (!is_available && index != _current) {
+			continue;
+		}
+
+		// only the slot about to be reused may block here, and only if the GPU is QUERY_COUNT frames behind
+		GLuint64 elapsed_ns = 0;
+		glGetQueryObjectui64v(_queries[index], GL_QUERY_RESULT, &elapsed_ns);
+		_milliseconds = elapsed_ns / 1000000.0;
+		_is_pending[index] = false;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, _queries[_current]);
+}
+
+void GpuTimer::End() {
+	glEndQuery(GL_TIME_ELAPSED);
+	_is_pending[_current] = true;
+	_current = (_current + 1) % QUERY_COUNT;
+}
+
+double GpuTimer::GetMilliseconds() const {
+	return _milliseconds;
+}
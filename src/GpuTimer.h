@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Measures GPU time between Begin and End with GL_TIME_ELAPSED queries.
+// Results are read a few frames late from a ring of queries so reading never stalls the pipeline.
+// The destructor deletes the ring of queries, so a timer has to go while the context is current.
+class GpuTimer {
+public:
+	GpuTimer();
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+	~GpuTimer();
+
+	void Begin();
+	void End();
+
+	// last finished measurement
+	double GetMilliseconds() const;
+
+private:
+	static const int QUERY_COUNT = 4;
+
+	unsigned int _queries[QUERY_COUNT];
+	bool _is_pending[QUERY_COUNT];
+	int _current;
+	double _milliseconds;
+};
@@ -0,0 +1,63 @@
+#include "InstanceBuffer.h"
+
+#include <algorithm>
+#include <cstddef>
+
+InstanceBuffer::InstanceBuffer(size_t capacity) : _vbo(0), _capacity(std::max((size_t)1, capacity)), _count(0) {
+	glGenBuffers(1, &_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+	glBufferData(GL_ARRAY_BUFFER, _capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	_instances.reserve(_capacity);
+}
+
+InstanceBuffer::~InstanceBuffer() {
+	glDeleteBuffers(1, &_vbo);
+}
+
+void InstanceBuffer::Upload(const glm::mat4* model_matrices, size_t count) {
+	_instances.clear();
+	for (size_t i = 0; i < count; i++) {
+		InstanceData instance;
+		instance.Model = model_matrices[i];
+		// once per instance here instead of once per vertex in the shader
+		instance.Normal = glm::transpose(glm::inverse(glm::mat3(model_matrices[i])));
+		_instances.push_back(instance);
+	}
+	_count = count;
+
+	// the buffer keeps its name when it grows, so vertex arrays it is attached to stay valid
+	_capacity = std::max(_capacity, count);
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+	glBufferData(GL_ARRAY_BUFFER, _capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+	if (count > 0) {
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceData), _instances.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::Upload(const std::vector<glm::mat4>& model_matrices) {
+	Upload(model_matrices.data(), model_matrices.size());
+}
+
+size_t InstanceBuffer::GetCount() const {
+	return _count;
+}
+
+void InstanceBuffer::Attach() const {
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+	// matrices are passed one column per location
+	for (GLuint i = 0; i < 4; i++) {
+		GLuint location = FIRST_ATTRIBUTE_LOCATION + i;
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, Model) + i * sizeof(glm::vec4)));
+		glVertexAttribDivisor(location, 1);
+	}
+	for (GLuint i = 0; i < 3; i++) {
+		GLuint location = FIRST_ATTRIBUTE_LOCATION + 4 + i;
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, Normal) + i * sizeof(glm::vec3)));
+		glVertexAttribDivisor(location, 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Per instance transforms for instanced draws: the model matrix and its precomputed normal matrix,
+// streamed to one vertex buffer. Instanced vertex shaders read them from attribute locations 3 to 9.
+// Upload once per frame, then draw from it in every pass. Its vertex buffer is deleted with it, while the context is current.
+class InstanceBuffer {
+public:
+	// the model matrix takes four locations from here, the normal matrix the three after
+	static const GLuint FIRST_ATTRIBUTE_LOCATION = 3;
+
+	InstanceBuffer(size_t capacity);
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+	~InstanceBuffer();
+
+	// replaces the instances, the previous contents are orphaned so the GPU can keep reading them
+	void Upload(const glm::mat4* model_matrices, size_t count);
+	void Upload(const std::vector<glm::mat4>& model_matrices);
+	size_t GetCount() const;
+
+	// points the instance attributes of the bound vertex array at this buffer
+	void Attach() const;
+
+private:
+	struct InstanceData {
+		glm::mat4 Model;
+		glm::mat3 Normal;
+	};
+
+	unsigned int _vbo;
+	size_t _capacity;
+	size_t _count;
+	// reused between uploads so streaming does not allocate
+	std::vector<InstanceData> _instances;
+};
@@ -0,0 +1,112 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : _data(nullptr), _size(0), _file(INVALID_HANDLE_VALUE), _mapping(NULL) {
+}
+#else
+MappedFile::MappedFile() : _data(nullptr), _size(0), _file(-1) {
+}
+#endif
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+bool MappedFile::Open(const std::string& path) {
+	Close();
+
+#ifdef _WIN32
+	_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (_file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0) {
+		Close();
+		return false;
+	}
+
+	_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mapping == NULL) {
+		Close();
+		return false;
+	}
+
+	_data = (const unsigned char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (_data == nullptr) {
+		Close();
+		return false;
+	}
+	_size = (size_t)size.QuadPart;
+#else
+	_file = open(path.c_str(), O_RDONLY);
+	if (_file < 0) {
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(_file, &status) != 0 || status.st_size == 0) {
+		Close();
+		return false;
+	}
+
+	void* data = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, _file, 0);
+	if (data == MAP_FAILED) {
+		Close();
+		return false;
+	}
+	_data = (const unsigned char*)data;
+	_size = (size_t)status.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::Close() {
+#ifdef _WIN32
+	if (_data != nullptr) {
+		UnmapViewOfFile(_data);
+	}
+	if (_mapping != NULL) {
+		CloseHandle(_mapping);
+		_mapping = NULL;
+	}
+	if (_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(_file);
+		_file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (_data != nullptr) {
+		munmap((void*)_data, _size);
+	}
+	if (_file >= 0) {
+		close(_file);
+		_file = -1;
+	}
+#endif
+	_data = nullptr;
+	_size = 0;
+}
+
+bool MappedFile::IsOpen() const {
+	return _data != nullptr;
+}
+
+const unsigned char* MappedFile::GetData() const {
+	return _data;
+}
+
+size_t MappedFile::GetSize() const {
+	return _size;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read only view of a whole file through the OS page cache (mmap, MapViewOfFile on Windows).
+// Nothing is read up front, pages come in as they are touched.
+class MappedFile {
+public:
+	MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	// false when the file is missing or empty
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen() const;
+	const unsigned char* GetData() const;
+	size_t GetSize() const;
+
+private:
+	const unsigned char* _data;
+	size_t _size;
+#ifdef _WIN32
+	// HANDLEs, kept as void* so this header does not pull in windows.h
+	void* _file;
+	void* _mapping;
+#else
+	int _file;
+#endif
+};
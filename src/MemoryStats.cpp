@@ -0,0 +1,109 @@
+#include "MemoryStats.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static std::atomic<size_t> allocation_count(0);
+static std::atomic<size_t> allocated_bytes(0);
+
+size_t MemoryStats::GetAllocationCount() {
+	return allocation_count.load(std::memory_order_relaxed);
+}
+
+size_t MemoryStats::GetAllocatedBytes() {
+	return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+size_t MemoryStats::GetPeakResidentBytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		// reported in kilobytes
+		return (size_t)usage.ru_maxrss * 1024;
+	}
+	return 0;
+#endif
+}
+
+ScopedLoadReport::ScopedLoadReport(std::string label) : _label(std::move(label)) {
+	_allocation_start = MemoryStats::GetAllocationCount();
+	_allocated_bytes_start = MemoryStats::GetAllocatedBytes();
+	_time_start = std::chrono::steady_clock::now();
+}
+
+ScopedLoadReport::~ScopedLoadReport() {
+	double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _time_start).count();
+	size_t allocations = MemoryStats::GetAllocationCount() - _allocation_start;
+	size_t allocated_bytes = MemoryStats::GetAllocatedBytes() - _allocated_bytes_start;
+
+	std::cout << "LOAD " << _label << ": " << elapsed_ms << " ms, "
+		<< allocations << " allocations (" << allocated_bytes / (1024.0 * 1024.0) << " MB), "
+		<< "peak RSS " << MemoryStats::GetPeakResidentBytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
+static void* counted_allocate(size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(size_t size) {
+	void* memory = counted_allocate(size);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return counted_allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return counted_allocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	std::free(memory);
+}
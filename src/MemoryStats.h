@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// Counts every allocation that goes through the global operator new so hot paths
+// (e.g. the frame loop) can be checked for heap traffic.
+class MemoryStats {
+public:
+	static size_t GetAllocationCount();
+	static size_t GetAllocatedBytes();
+	// peak working set of the process as reported by the OS
+	static size_t GetPeakResidentBytes();
+};
+
+// Prints time, allocation count, allocated bytes and peak RSS of a load step when it goes out of scope.
+class ScopedLoadReport {
+public:
+	ScopedLoadReport(std::string label);
+	~ScopedLoadReport();
+
+private:
+	std::string _label;
+	size_t _allocation_start;
+	size_t _allocated_bytes_start;
+	std::chrono::steady_clock::time_point _time_start;
+};
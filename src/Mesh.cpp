@@ -1,66 +1,479 @@
 #include "Mesh.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) {
-	this->Vertices = vertices;
-	this->Indices = indices;
-	this->Textures = textures;
+#include <cstring>
+#include <map>
+#include <utility>
 
-	Setup();
+// hands out one id per distinct set of (texture, type) pairs, in the order they are first seen
+static unsigned int RegisterMaterial(const std::vector<Texture>& textures) {
+    static std::map<std::vector<std::pair<unsigned int, std::string>>, unsigned int> material_ids;
+
+    std::vector<std::pair<unsigned int, std::string>> key;
+    key.reserve(textures.size());
+    for (const Texture& texture : textures) {
+        key.push_back(std::make_pair(texture.Id, texture.Type));
+    }
+
+    auto found = material_ids.find(key);
+    if (found != material_ids.end()) {
+        return found->second;
+    }
+
+    unsigned int id = (unsigned int)material_ids.size();
+    material_ids.emplace(std::move(key), id);
+    return id;
+}
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, MeshOptions options)
+    : Vertices(std::move(vertices)), Indices(std::move(indices)), Textures(std::move(textures)) {
+    // the cooked data is gone before staging would get to it
+    Setup(Cook(Vertices, Indices, options), options, nullptr);
+    ApplyResidency(options.Residency);
+}
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, const CookedMesh& cooked, std::vector<Texture> textures, const MeshOptions& options)
+    : Vertices(std::move(vertices)), Indices(std::move(indices)), Textures(std::move(textures)) {
+    Setup(cooked, options, options.Staging);
+    ApplyResidency(options.Residency);
+}
+
+Mesh::Mesh(const CookedMesh& cooked, std::vector<Texture> textures, const MeshOptions& options) : Textures(std::move(textures)) {
+    Setup(cooked, options, options.Staging);
+}
+
+CookedMesh Mesh::Cook(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const MeshOptions& options) {
+    CookedMesh cooked;
+    cooked.VertexCount = (unsigned int)vertices.size();
+    cooked.IndexCount = (unsigned int)indices.size();
+    cooked.MeshBounds = Bounds::FromPoints(vertices, [](const Vertex& vertex) { return vertex.Position; });
+
+    if (options.MeshletTriangles > 0 && cooked.IndexCount / 3 >= MIN_MESHLETS * options.MeshletTriangles) {
+        cooked.Meshlets = MeshProcessing::BuildMeshlets(vertices, indices, options.MeshletTriangles);
+    }
+
+    std::vector<unsigned int> gpu_indices = BuildLods(vertices, indices, options.LodCount, options.Optimize, cooked);
+    cooked.GpuIndexCount = (unsigned int)gpu_indices.size();
+
+    cooked.Format = options.Format;
+    BoundingBox quantization_bounds = options.HasQuantizationBounds ? options.QuantizationBounds : cooked.MeshBounds.Box;
+    switch (options.Format) {
+    case VertexFormat::HalfFloat:
+        PackVertices<HalfFloatVertexLayout>(vertices, quantization_bounds, cooked);
+        break;
+    case VertexFormat::Quantized:
+        PackVertices<QuantizedVertexLayout>(vertices, quantization_bounds, cooked);
+        break;
+    default:
+        PackVertices<FullVertexLayout>(vertices, quantization_bounds, cooked);
+        break;
+    }
+
+    // every vertex is addressable with 16 bits, halve the index buffer
+    if (cooked.VertexCount <= MAX_SHORT_INDEX_VERTICES) {
+        cooked.IndexType = GL_UNSIGNED_SHORT;
+        std::vector<unsigned short> short_indices(gpu_indices.begin(), gpu_indices.end());
+        cooked.IndexStorage.resize(short_indices.size() * sizeof(unsigned short));
+        if (!short_indices.empty()) {
+            std::memcpy(cooked.IndexStorage.data(), short_indices.data(), cooked.IndexStorage.size());
+        }
+    }
+    else {
+        cooked.IndexType = GL_UNSIGNED_INT;
+        cooked.IndexStorage.resize(gpu_indices.size() * sizeof(unsigned int));
+        if (!gpu_indices.empty()) {
+            std::memcpy(cooked.IndexStorage.data(), gpu_indices.data(), cooked.IndexStorage.size());
+        }
+    }
+
+    cooked.VertexData = cooked.VertexStorage.data();
+    cooked.IndexData = cooked.IndexStorage.data();
+    return cooked;
+}
+
+Mesh::Mesh(Mesh&& other) noexcept : _vao(0), _vbo(0), _ebo(0), _arena(nullptr) {
+    *this = std::move(other);
+}
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept {
+    if (this != &other) {
+        Release();
+
+        Vertices = std::move(other.Vertices);
+        Indices = std::move(other.Indices);
+        Textures = std::move(other.Textures);
+        Positions = std::move(other.Positions);
+        _sampler_slots = std::move(other._sampler_slots);
+        _material_id = other._material_id;
+        _meshlets = std::move(other._meshlets);
+
+        _vao = other._vao;
+        _vbo = other._vbo;
+        _ebo = other._ebo;
+        _vertex_count = other._vertex_count;
+        _index_count = other._index_count;
+        _gpu_index_count = other._gpu_index_count;
+        _lods = std::move(other._lods);
+        _index_type = other._index_type;
+        _vertex_stride = other._vertex_stride;
+        _quantization = other._quantization;
+        _is_octahedral = other._is_octahedral;
+        _bounds = other._bounds;
+        _arena = other._arena;
+        _base_vertex = other._base_vertex;
+        _first_index = other._first_index;
+        other._vao = 0;
+        other._vbo = 0;
+        other._ebo = 0;
+    }
+    return *this;
+}
+
+Mesh::~Mesh() {
+    Release();
+}
+
+void Mesh::Draw(const Shader& shader) const {
+    Bind(shader);
+    glDrawElementsBaseVertex(GL_TRIANGLES, _index_count, _index_type, (const void*)((size_t)_first_index * GetIndexSize()), _base_vertex);
+    glBindVertexArray(0);
+}
+
+void Mesh::DrawInstanced(const Shader& shader, const InstanceBuffer& instances) const {
+    if (instances.GetCount() == 0) {
+        return;
+    }
+
+    Bind(shader);
+    instances.Attach();
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, _index_count, _index_type, (const void*)((size_t)_first_index * GetIndexSize()),
+        (GLsizei)instances.GetCount(), _base_vertex);
+    glBindVertexArray(0);
+}
+
+unsigned int Mesh::Cull(const DrawView& object_view, CullingStats& stats, DrawList& list) const {
+    // sphere first as the cheaper test, then the tighter box
+    if (!object_view.ViewFrustum.Intersects(_bounds.Sphere) || !object_view.ViewFrustum.Intersects(_bounds.Box)) {
+        stats.Culled++;
+        return 0;
+    }
+
+    unsigned int index_size = GetIndexSize();
+    unsigned int lod = SelectLod(object_view);
+    if (lod > 0) {
+        stats.Drawn++;
+        stats.Triangles += _lods[lod].IndexCount / 3;
+        list.Add(_lods[lod].IndexCount, (size_t)(_first_index + _lods[lod].IndexOffset) * index_size, _base_vertex);
+        return 1;
+    }
+
+    if (_meshlets.empty() || !object_view.MeshletCulling) {
+        stats.Drawn++;
+        stats.Triangles += _index_count / 3;
+        list.Add(_index_count, (size_t)_first_index * index_size, _base_vertex);
+        return 1;
+    }
+
+    unsigned int range_count = 0;
+    unsigned int range_end = 0;
+    for (const Meshlet& meshlet : _meshlets) {
+        if (!object_view.ViewFrustum.Intersects(meshlet.Sphere) || (object_view.ConeCulling && meshlet.IsBackFacing(object_view.Position))) {
+            stats.MeshletsCulled++;
+            continue;
+        }
+        stats.Triangles += meshlet.IndexCount / 3;
+
+        // neighbouring visible meshlets are merged into one range
+        if (range_count > 0 && range_end == meshlet.IndexOffset) {
+            list.Counts.back() += meshlet.IndexCount;
+        }
+        else {
+            list.Add(meshlet.IndexCount, (size_t)(_first_index + meshlet.IndexOffset) * index_size, _base_vertex);
+            range_count++;
+        }
+        range_end = meshlet.IndexOffset + meshlet.IndexCount;
+    }
+
+    if (range_count > 0) {
+        stats.Drawn++;
+    }
+    else {
+        stats.Culled++;
+    }
+    return range_count;
+}
+
+void Mesh::Submit(const DrawList& list) const {
+    if (_arena != nullptr) {
+        _arena->Submit(list);
+    }
+    else {
+        list.Submit(_index_type);
+    }
+}
+
+void Mesh::Bind(const Shader& shader) const {
+    const MeshUniforms& uniforms = shader.GetMeshUniforms();
+    for (unsigned int i = 0; i < Textures.size(); i++) {
+        glActiveTexture(GL_TEXTURE0 + i);
+
+        if (_sampler_slots[i] >= 0) {
+            shader.Set(uniforms.Samplers[_sampler_slots[i]], (int)i);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, Textures[i].Id);
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+
+    // lets the vertex shader decode whichever vertex format this mesh was uploaded with
+    shader.Set(uniforms.PositionOffset, _quantization.PositionOffset);
+    shader.Set(uniforms.PositionScale, _quantization.PositionScale);
+    shader.Set(uniforms.OctahedralNormals, _is_octahedral);
+
+    if (_arena != nullptr) {
+        _arena->Bind();
+    }
+    else {
+        glBindVertexArray(_vao);
+    }
 }
 
-void Mesh::Draw(Shader shader) {
+const Bounds& Mesh::GetBounds() const {
+    return _bounds;
+}
+
+const std::vector<Meshlet>& Mesh::GetMeshlets() const {
+    return _meshlets;
+}
+
+const std::vector<MeshLod>& Mesh::GetLods() const {
+    return _lods;
+}
+
+unsigned int Mesh::SelectLod(const DrawView& object_view) const {
+    if (_lods.empty() || object_view.LodPixelScale <= 0.0f) {
+        return 0;
+    }
+
+    float pixels_per_unit = object_view.LodPixelScale;
+    if (!object_view.IsOrthographic) {
+        // distance to the nearest point of the bounds, so the error is never underestimated
+        float distance = glm::length(_bounds.Sphere.Center - object_view.Position) - _bounds.Sphere.Radius;
+        if (distance <= 0.0f) {
+            return 0;
+        }
+        pixels_per_unit /= distance;
+    }
+
+    // errors grow with every level
+    unsigned int lod = 0;
+    while (lod + 1 < _lods.size() && _lods[lod + 1].Error * pixels_per_unit <= object_view.LodErrorPixels) {
+        lod++;
+    }
+    return lod;
+}
+
+unsigned int Mesh::GetTriangleCount() const {
+    return _index_count / 3;
+}
+
+unsigned int Mesh::GetMaterialId() const {
+    return _material_id;
+}
+
+unsigned int Mesh::GetVertexArray() const {
+    return _arena != nullptr ? _arena->GetVertexArray() : _vao;
+}
+
+GLenum Mesh::GetIndexType() const {
+    return _index_type;
+}
+
+const std::vector<int>& Mesh::GetSamplerSlots() const {
+    return _sampler_slots;
+}
+
+const VertexQuantization& Mesh::GetQuantization() const {
+    return _quantization;
+}
+
+bool Mesh::IsOctahedral() const {
+    return _is_octahedral;
+}
+
+size_t Mesh::GetCpuBytes() const {
+    return Vertices.capacity() * sizeof(Vertex) + Indices.capacity() * sizeof(unsigned int) + Positions.capacity() * sizeof(glm::vec3);
+}
+
+size_t Mesh::GetGpuBytes() const {
+    return (size_t)_vertex_count * _vertex_stride + (size_t)_gpu_index_count * GetIndexSize();
+}
+
+size_t Mesh::GetIndexBytesSaved() const {
+    return (size_t)_gpu_index_count * (sizeof(unsigned int) - GetIndexSize());
+}
+
+unsigned int Mesh::GetIndexSize() const {
+    return _index_type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+void Mesh::Setup(const CookedMesh& cooked, const MeshOptions& options, UploadRing* staging) {
     unsigned int diffuse_index = 0;
     unsigned int specular_index = 0;
+    unsigned int splatmap_index = 0;
+    _sampler_slots.reserve(Textures.size());
     for (unsigned int i = 0; i < Textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        
-        std::string number;
-        std::string type = Textures[i].Type;
+        const std::string& type = Textures[i].Type;
 
         if (type == "diffuse") {
-            number = std::to_string(diffuse_index++);
-            shader.SetInt(("texture_diffuse" + number).c_str(), i);
+            _sampler_slots.push_back(MeshUniforms::GetSamplerSlot(type, diffuse_index++));
         }
         else if (type == "specular") {
-            number = std::to_string(specular_index++);
-            shader.SetInt(("texture_specular" + number).c_str(), i);
+            _sampler_slots.push_back(MeshUniforms::GetSamplerSlot(type, specular_index++));
         }
         else if (type == "splat") {
-            shader.SetInt("texture_splatmap", i);
+            _sampler_slots.push_back(MeshUniforms::GetSamplerSlot(type, splatmap_index++));
+        }
+        else {
+            _sampler_slots.push_back(-1);
         }
+    }
 
-        glBindTexture(GL_TEXTURE_2D, Textures[i].Id);
+    _material_id = RegisterMaterial(Textures);
+
+    _vertex_count = cooked.VertexCount;
+    _index_count = cooked.IndexCount;
+    _gpu_index_count = cooked.GpuIndexCount;
+    _index_type = cooked.IndexType;
+    _vertex_stride = cooked.VertexStride;
+    _quantization = cooked.Quantization;
+    _is_octahedral = cooked.IsOctahedral;
+    _bounds = cooked.MeshBounds;
+    _meshlets = cooked.Meshlets;
+    _lods = cooked.Lods;
+
+    _vao = 0;
+    _vbo = 0;
+    _ebo = 0;
+    _arena = nullptr;
+    _base_vertex = 0;
+    _first_index = 0;
+
+    // short indices can come from the arena, which only holds 16 bit indices
+    if (_index_type == GL_UNSIGNED_SHORT && options.Arena != nullptr && options.Arena->GetFormat() == cooked.Format) {
+        GeometryArena::Allocation allocation = options.Arena->Allocate(cooked.VertexData, cooked.GetVertexBytes(),
+            (const unsigned short*)cooked.IndexData, cooked.GpuIndexCount, staging);
+        _arena = options.Arena;
+        _base_vertex = allocation.BaseVertex;
+        _first_index = allocation.FirstIndex;
     }
+    else {
+        UploadBuffers(cooked.Format, cooked.VertexData, cooked.GetVertexBytes(), cooked.IndexData, cooked.GetIndexBytes(), staging);
+    }
+}
 
-    glActiveTexture(GL_TEXTURE0);
+std::vector<unsigned int> Mesh::BuildLods(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    unsigned int lod_count, bool optimize, CookedMesh& cooked) {
+    // how far each level may move the surface, relative to the mesh radius
+    const float MAX_LOD_STEP_ERROR = 0.05f;
 
-    glBindVertexArray(_vao);
-    glDrawElements(GL_TRIANGLES, Indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    std::vector<unsigned int> gpu_indices = indices;
+    if (lod_count == 0 || indices.size() / 3 < MIN_LOD_TRIANGLES) {
+        return gpu_indices;
+    }
+
+    std::vector<MeshLod>& lods = cooked.Lods;
+    lods.push_back({ 0, (unsigned int)indices.size(), 0.0f });
+
+    std::vector<unsigned int> previous = indices;
+    float error = 0.0f;
+    for (unsigned int level = 0; level < lod_count; level++) {
+        float step_error = 0.0f;
+        size_t target_index_count = previous.size() / 6 * 3;
+        std::vector<unsigned int> lod = MeshProcessing::Simplify(vertices, previous, target_index_count, cooked.MeshBounds.Sphere.Radius * MAX_LOD_STEP_ERROR, step_error);
+
+        // a level that barely shrinks is not worth its index memory, neither are the ones after it
+        if (lod.empty() || lod.size() * 10 > previous.size() * 9) {
+            break;
+        }
+        if (optimize) {
+            MeshProcessing::OptimizeVertexCache(lod, vertices.size());
+        }
+
+        // each level is simplified from the one before, so the errors add up
+        error += step_error;
+        lods.push_back({ (unsigned int)gpu_indices.size(), (unsigned int)lod.size(), error });
+        gpu_indices.insert(gpu_indices.end(), lod.begin(), lod.end());
+        previous = std::move(lod);
+    }
+
+    if (lods.size() < 2) {
+        lods.clear();
+    }
+    return gpu_indices;
+}
+
+template <typename Layout>
+void Mesh::PackVertices(const std::vector<Vertex>& vertices, const BoundingBox& quantization_bounds, CookedMesh& cooked) {
+    cooked.VertexStride = Layout::Stride;
+    cooked.Quantization = Layout::ComputeQuantization(quantization_bounds.Min, quantization_bounds.Max);
+    cooked.IsOctahedral = Layout::IsOctahedral;
+    cooked.VertexStorage = Layout::Pack(vertices, cooked.Quantization);
 }
 
-void Mesh::Setup() {
+void Mesh::UploadBuffers(VertexFormat format, const void* packed_vertices, size_t vertex_bytes, const void* indices, size_t index_bytes,
+    UploadRing* staging) {
     glGenVertexArrays(1, &_vao);
     glGenBuffers(1, &_vbo);
     glGenBuffers(1, &_ebo);
 
+    // staged buffers are only allocated here, the ring fills them over the next frames
     glBindVertexArray(_vao);
     glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-
-    glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(Vertex), &Vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertex_bytes, staging != nullptr ? NULL : packed_vertices, GL_STATIC_DRAW);
+    SetupVertexAttributes(format);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, Indices.size() * sizeof(unsigned int), &Indices[0], GL_STATIC_DRAW);
-
-    // vertex positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TextureCoordinates));
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bytes, staging != nullptr ? NULL : indices, GL_STATIC_DRAW);
 
     glBindVertexArray(0);
+
+    if (staging != nullptr) {
+        staging->QueueBuffer(_vbo, 0, packed_vertices, vertex_bytes);
+        staging->QueueBuffer(_ebo, 0, indices, index_bytes);
+    }
+}
+
+void Mesh::ApplyResidency(GeometryResidency residency) {
+    if (residency == GeometryResidency::Keep) {
+        return;
+    }
+
+    if (residency == GeometryResidency::PositionsOnly) {
+        Positions.reserve(Vertices.size());
+        for (const Vertex& vertex : Vertices) {
+            Positions.push_back(vertex.Position);
+        }
+    }
+    else {
+        std::vector<unsigned int>().swap(Indices);
+    }
+
+    // swap with an empty vector so the capacity is returned as well
+    std::vector<Vertex>().swap(Vertices);
+}
+
+void Mesh::Release() {
+    if (_vao != 0) {
+        glDeleteVertexArrays(1, &_vao);
+        _vao = 0;
+    }
+    if (_vbo != 0) {
+        glDeleteBuffers(1, &_vbo);
+        _vbo = 0;
+    }
+    if (_ebo != 0) {
+        glDeleteBuffers(1, &_ebo);
+        _ebo = 0;
+    }
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include <glad/glad.h>
@@ -8,25 +9,192 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "Bounds.h"
+#include "Frustum.h"
+#include "GeometryArena.h"
+#include "InstanceBuffer.h"
+#include "MeshProcessing.h"
 #include "Vertex.h"
+#include "VertexLayout.h"
 #include "Texture.h"
 #include "Shader.h"
 
+// What a mesh keeps in RAM once its geometry is uploaded to the GPU
+enum class GeometryResidency {
+	Keep,
+	DropAfterUpload,
+	// keeps only Positions (and Indices) for CPU side queries
+	PositionsOnly
+};
+
+// Import time settings shared by all meshes of a model
+struct MeshOptions {
+	GeometryResidency Residency = GeometryResidency::Keep;
+	VertexFormat Format = VertexFormat::Full;
+	// reorder triangles and vertices for the vertex cache, overdraw and vertex fetch after import
+	bool Optimize = false;
+	// triangles per meshlet for meshlet culling, 0 draws every mesh whole
+	unsigned int MeshletTriangles = 0;
+	// coarser levels of detail generated per mesh, each with about half the triangles of the one before
+	unsigned int LodCount = 0;
+	// threads converting the meshes of a model on import, 0 uses every core
+	unsigned int ImportThreads = 0;
+	// suballocate from this arena instead of owning buffers, meshes of another format or too many
+	// vertices for 16 bit indices still get their own
+	GeometryArena* Arena = nullptr;
+	// queue geometry here instead of copying it in the constructor, the cooked data handed to the mesh then
+	// has to outlive the copies. Meshes that cook their own data always copy.
+	UploadRing* Staging = nullptr;
+	// quantize positions against these bounds instead of each mesh's own, so meshes of a model decode
+	// the same way and can share a draw
+	bool HasQuantizationBounds = false;
+	BoundingBox QuantizationBounds;
+};
+
+// One level of detail: a range of the mesh's index buffer over the shared vertices
+struct MeshLod {
+	unsigned int IndexOffset;
+	unsigned int IndexCount;
+	// largest object space distance from the full detail surface
+	float Error;
+};
+
+// A mesh after all import time processing: packed vertices and indices ready for the GPU plus what is kept
+// on the CPU. Mesh::Cook produces it and .loglmesh caches store it as is, so a cached mesh skips straight to upload.
+// Move only, since the data pointers may point into its own storage.
+struct CookedMesh {
+	VertexFormat Format = VertexFormat::Full;
+	unsigned int VertexCount = 0;
+	unsigned int VertexStride = 0;
+	// full detail indices, coarser levels follow them in the index data
+	unsigned int IndexCount = 0;
+	unsigned int GpuIndexCount = 0;
+	GLenum IndexType = GL_UNSIGNED_INT;
+	VertexQuantization Quantization;
+	bool IsOctahedral = false;
+	Bounds MeshBounds;
+	std::vector<Meshlet> Meshlets;
+	std::vector<MeshLod> Lods;
+	// point into the storage below, or into a mapped cache file that outlives the upload
+	const unsigned char* VertexData = nullptr;
+	const unsigned char* IndexData = nullptr;
+	std::vector<unsigned char> VertexStorage;
+	std::vector<unsigned char> IndexStorage;
+
+	CookedMesh() = default;
+	CookedMesh(const CookedMesh&) = delete;
+	CookedMesh& operator=(const CookedMesh&) = delete;
+	CookedMesh(CookedMesh&&) = default;
+	CookedMesh& operator=(CookedMesh&&) = default;
+
+	size_t GetVertexBytes() const {
+		return (size_t)VertexCount * VertexStride;
+	}
+
+	size_t GetIndexBytes() const {
+		return (size_t)GpuIndexCount * (IndexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int));
+	}
+};
+
+// Owns its vertex array and buffers (or its range of a GeometryArena), so it can only be moved, never copied.
 class Mesh {
 public:
+	// meshes up to this many vertices get 16 bit indices
+	static const unsigned int MAX_SHORT_INDEX_VERTICES = 65536;
+	// meshes that would end up with fewer meshlets than this are not worth the extra draw ranges
+	static const unsigned int MIN_MESHLETS = 4;
+	// smaller meshes draw just as fast at full detail
+	static const unsigned int MIN_LOD_TRIANGLES = 256;
+
 	std::vector<Vertex> Vertices;
 	std::vector<unsigned int> Indices;
 	std::vector<Texture> Textures;
+	// filled only with the PositionsOnly residency
+	std::vector<glm::vec3> Positions;
 
 public:
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-	void Draw(Shader shader);
+	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, MeshOptions options = MeshOptions());
+	// uploads geometry cooked from vertices and indices elsewhere, e.g. on a worker thread
+	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, const CookedMesh& cooked, std::vector<Texture> textures, const MeshOptions& options);
+	// uploads already cooked geometry, nothing is kept on the CPU whatever the residency
+	Mesh(const CookedMesh& cooked, std::vector<Texture> textures, const MeshOptions& options = MeshOptions());
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&& other) noexcept;
+	Mesh& operator=(Mesh&& other) noexcept;
+	~Mesh();
+
+	// everything the constructor does before upload, for callers that also want to store the result
+	static CookedMesh Cook(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const MeshOptions& options);
+
+	void Draw(const Shader& shader) const;
+	// draws every instance of the buffer at full detail, the shader takes the transforms from the instance attributes
+	void DrawInstanced(const Shader& shader, const InstanceBuffer& instances) const;
+	// culls the mesh, then its meshlets, against a view already in this mesh's object space and appends
+	// the index ranges left to draw, returns how many were added
+	unsigned int Cull(const DrawView& object_view, CullingStats& stats, DrawList& list) const;
+	// draws ranges of this mesh's vertex array, which may include ranges of other meshes sharing its arena
+	void Submit(const DrawList& list) const;
+
+	// object space bounds, computed before upload so they survive any residency policy
+	const Bounds& GetBounds() const;
+	const std::vector<Meshlet>& GetMeshlets() const;
+	// empty when the mesh has no coarser levels, otherwise level 0 is the full detail
+	const std::vector<MeshLod>& GetLods() const;
+	// the coarsest level the view accepts, meshlets are only used at level 0
+	unsigned int SelectLod(const DrawView& object_view) const;
+	unsigned int GetTriangleCount() const;
+
+	// state a render queue sorts and filters redundant binds by
+	// meshes with the same textures in the same sampler slots share a material id
+	unsigned int GetMaterialId() const;
+	unsigned int GetVertexArray() const;
+	GLenum GetIndexType() const;
+	// MeshUniforms::Samplers slot per texture, -1 for textures no sampler takes
+	const std::vector<int>& GetSamplerSlots() const;
+	const VertexQuantization& GetQuantization() const;
+	bool IsOctahedral() const;
+
+	size_t GetCpuBytes() const;
+	size_t GetGpuBytes() const;
+	// index buffer bytes saved by uploading 16 bit instead of 32 bit indices
+	size_t GetIndexBytesSaved() const;
 
 private:
 	unsigned int _vao;
 	unsigned int _vbo;
 	unsigned int _ebo;
+	// counts of the uploaded buffers, valid even after the CPU copies are released
+	unsigned int _vertex_count;
+	unsigned int _index_count;
+	// all levels of detail, the uploaded index buffer
+	unsigned int _gpu_index_count;
+	GLenum _index_type;
+	unsigned int _vertex_stride;
+	VertexQuantization _quantization;
+	bool _is_octahedral;
+	Bounds _bounds;
+	// sampler per texture, resolved once so drawing neither builds strings nor looks names up
+	std::vector<int> _sampler_slots;
+	unsigned int _material_id;
+	std::vector<Meshlet> _meshlets;
+	std::vector<MeshLod> _lods;
+	GeometryArena* _arena;
+	// where this mesh's geometry starts in the arena, both 0 with own buffers
+	unsigned int _base_vertex;
+	unsigned int _first_index;
 
 private:
-	void Setup();
-};
\ No newline at end of file
+	void Setup(const CookedMesh& cooked, const MeshOptions& options, UploadRing* staging);
+	template <typename Layout>
+	static void PackVertices(const std::vector<Vertex>& vertices, const BoundingBox& quantization_bounds, CookedMesh& cooked);
+	void UploadBuffers(VertexFormat format, const void* packed_vertices, size_t vertex_bytes, const void* indices, size_t index_bytes,
+		UploadRing* staging);
+	// simplifies indices into cooked.Lods and returns every level's indices in upload order
+	static std::vector<unsigned int> BuildLods(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+		unsigned int lod_count, bool optimize, CookedMesh& cooked);
+	void ApplyResidency(GeometryResidency residency);
+	void Bind(const Shader& shader) const;
+	unsigned int GetIndexSize() const;
+	void Release();
+};
@@ -0,0 +1,323 @@
+#include "MeshCache.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char MAGIC[8] = { 'L', 'O', 'G', 'L', 'M', 'S', 'H', '\0' };
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+static const size_t BLOB_ALIGNMENT = 16;
+
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * FNV_PRIME;
+	}
+	return hash;
+}
+
+template <typename T>
+static uint64_t HashValue(uint64_t hash, const T& value) {
+	return HashBytes(hash, &value, sizeof(value));
+}
+
+static size_t Align(size_t offset) {
+	return (offset + BLOB_ALIGNMENT - 1) / BLOB_ALIGNMENT * BLOB_ALIGNMENT;
+}
+
+// appends at the next aligned offset of the file being built and returns where it went
+static uint64_t AppendBlob(std::vector<unsigned char>& file, const void* data, size_t size) {
+	file.resize(Align(file.size()));
+	uint64_t offset = file.size();
+	if (size > 0) {
+		file.resize(file.size() + size);
+		std::memcpy(file.data() + offset, data, size);
+	}
+	return offset;
+}
+
+static void AppendString(std::vector<unsigned char>& file, const std::string& value) {
+	uint32_t length = (uint32_t)value.size();
+	const unsigned char* length_bytes = (const unsigned char*)&length;
+	file.insert(file.end(), length_bytes, length_bytes + sizeof(length));
+	file.insert(file.end(), value.begin(), value.end());
+}
+
+MeshCache::MeshCache() : _records_offset(0) {
+}
+
+bool MeshCache::Open(const std::string& path, uint64_t source_hash, uint64_t options_hash) {
+	Close();
+	if (!_file.Open(path)) {
+		return false;
+	}
+
+	FileHeader header;
+	if (_file.GetSize() < sizeof(header)) {
+		Close();
+		return false;
+	}
+	std::memcpy(&header, _file.GetData(), sizeof(header));
+
+	if (std::memcmp(header.Magic, MAGIC, sizeof(MAGIC)) != 0 || header.Version != VERSION ||
+		header.SourceHash != source_hash || header.OptionsHash != options_hash) {
+		std::cout << "MESH CACHE " << path << ": stale, importing again" << std::endl;
+		Close();
+		return false;
+	}
+
+	size_t offset = sizeof(header);
+	if (!ReadMaterials(offset, header.MaterialCount)) {
+		Close();
+		return false;
+	}
+
+	_records_offset = Align(offset);
+	if (!IsInFile(_records_offset, (uint64_t)header.MeshCount * sizeof(MeshRecord))) {
+		Close();
+		return false;
+	}
+
+	// every blob is checked once here, so GetMesh can trust the records
+	_mesh_materials.reserve(header.MeshCount);
+	for (uint32_t i = 0; i < header.MeshCount; i++) {
+		MeshRecord record = ReadRecord(i);
+		uint64_t index_size = record.IndexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+		if (record.Material >= _materials.size() ||
+			!IsInFile(record.MeshletOffset, (uint64_t)record.MeshletCount * sizeof(Meshlet)) ||
+			!IsInFile(record.LodOffset, (uint64_t)record.LodCount * sizeof(MeshLod)) ||
+			!IsInFile(record.VertexOffset, (uint64_t)record.VertexCount * record.VertexStride) ||
+			!IsInFile(record.IndexOffset, (uint64_t)record.GpuIndexCount * index_size)) {
+			std::cout << "MESH CACHE " << path << ": truncated, importing again" << std::endl;
+			Close();
+			return false;
+		}
+		_mesh_materials.push_back(record.Material);
+	}
+	return true;
+}
+
+void MeshCache::Close() {
+	_file.Close();
+	_records_offset = 0;
+	_materials.clear();
+	_mesh_materials.clear();
+}
+
+size_t MeshCache::GetMeshCount() const {
+	return _file.IsOpen() ? _mesh_materials.size() : _meshes.size();
+}
+
+CookedMesh MeshCache::GetMesh(size_t index) const {
+	MeshRecord record = ReadRecord(index);
+	const unsigned char* data = _file.GetData();
+
+	CookedMesh mesh;
+	mesh.Format = (VertexFormat)record.Format;
+	mesh.VertexCount = record.VertexCount;
+	mesh.VertexStride = record.VertexStride;
+	mesh.IndexCount = record.IndexCount;
+	mesh.GpuIndexCount = record.GpuIndexCount;
+	mesh.IndexType = record.IndexType;
+	mesh.Quantization = record.Quantization;
+	mesh.IsOctahedral = record.IsOctahedral != 0;
+	mesh.MeshBounds = record.MeshBounds;
+
+	mesh.Meshlets.resize(record.MeshletCount);
+	if (record.MeshletCount > 0) {
+		std::memcpy(mesh.Meshlets.data(), data + record.MeshletOffset, record.MeshletCount * sizeof(Meshlet));
+	}
+	mesh.Lods.resize(record.LodCount);
+	if (record.LodCount > 0) {
+		std::memcpy(mesh.Lods.data(), data + record.LodOffset, record.LodCount * sizeof(MeshLod));
+	}
+
+	mesh.VertexData = data + record.VertexOffset;
+	mesh.IndexData = data + record.IndexOffset;
+	return mesh;
+}
+
+const std::vector<Texture>& MeshCache::GetTextures(size_t index) const {
+	return _materials[_mesh_materials[index]];
+}
+
+void MeshCache::Add(CookedMesh mesh, const std::vector<Texture>& textures) {
+	// meshes with the same textures share a material table entry
+	uint32_t material = 0;
+	for (; material < _materials.size(); material++) {
+		const std::vector<Texture>& other = _materials[material];
+		bool is_same = other.size() == textures.size();
+		for (size_t i = 0; is_same && i < textures.size(); i++) {
+			is_same = other[i].Path == textures[i].Path && other[i].Type == textures[i].Type;
+		}
+		if (is_same) {
+			break;
+		}
+	}
+	if (material == _materials.size()) {
+		_materials.push_back(textures);
+	}
+
+	_mesh_materials.push_back(material);
+	_meshes.push_back(std::move(mesh));
+}
+
+bool MeshCache::Write(const std::string& path, uint64_t source_hash, uint64_t options_hash) const {
+	std::vector<unsigned char> file(sizeof(FileHeader));
+
+	FileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.Magic, MAGIC, sizeof(MAGIC));
+	header.Version = VERSION;
+	header.MeshCount = (uint32_t)_meshes.size();
+	header.SourceHash = source_hash;
+	header.OptionsHash = options_hash;
+	header.MaterialCount = (uint32_t)_materials.size();
+	std::memcpy(file.data(), &header, sizeof(header));
+
+	for (const std::vector<Texture>& material : _materials) {
+		uint32_t texture_count = (uint32_t)material.size();
+		const unsigned char* count_bytes = (const unsigned char*)&texture_count;
+		file.insert(file.end(), count_bytes, count_bytes + sizeof(texture_count));
+		for (const Texture& texture : material) {
+			AppendString(file, texture.Type);
+			AppendString(file, texture.Path);
+		}
+	}
+
+	// records are filled in once the blobs after them have their offsets
+	size_t records_offset = Align(file.size());
+	file.resize(records_offset + _meshes.size() * sizeof(MeshRecord));
+
+	for (size_t i = 0; i < _meshes.size(); i++) {
+		const CookedMesh& mesh = _meshes[i];
+		MeshRecord record = MeshRecord();
+		record.Material = _mesh_materials[i];
+		record.Format = (uint32_t)mesh.Format;
+		record.VertexCount = mesh.VertexCount;
+		record.VertexStride = mesh.VertexStride;
+		record.IndexCount = mesh.IndexCount;
+		record.GpuIndexCount = mesh.GpuIndexCount;
+		record.IndexType = mesh.IndexType;
+		record.IsOctahedral = mesh.IsOctahedral ? 1 : 0;
+		record.Quantization = mesh.Quantization;
+		record.MeshBounds = mesh.MeshBounds;
+		record.MeshletCount = (uint32_t)mesh.Meshlets.size();
+		record.LodCount = (uint32_t)mesh.Lods.size();
+		record.MeshletOffset = AppendBlob(file, mesh.Meshlets.data(), mesh.Meshlets.size() * sizeof(Meshlet));
+		record.LodOffset = AppendBlob(file, mesh.Lods.data(), mesh.Lods.size() * sizeof(MeshLod));
+		record.VertexOffset = AppendBlob(file, mesh.VertexData, mesh.GetVertexBytes());
+		record.IndexOffset = AppendBlob(file, mesh.IndexData, mesh.GetIndexBytes());
+		std::memcpy(file.data() + records_offset + i * sizeof(MeshRecord), &record, sizeof(record));
+	}
+
+	// written next to the old cache and moved over it, so a crash never leaves a half written cache behind.
+	// The same model streamed in twice is cooked twice at once, so every writer gets its own temporary file.
+	static std::atomic<unsigned int> temporary_count(0);
+	std::string temporary_path = path + "." + std::to_string(temporary_count++) + ".tmp";
+	{
+		std::ofstream stream(temporary_path, std::ios::binary | std::ios::trunc);
+		if (!stream.write((const char*)file.data(), file.size())) {
+			std::cout << "MESH CACHE " << path << ": could not be written" << std::endl;
+			return false;
+		}
+	}
+	std::remove(path.c_str());
+	if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+		std::remove(temporary_path.c_str());
+		// another writer put its copy there first, cooked from the same model
+		if (std::ifstream(path, std::ios::binary).is_open()) {
+			return true;
+		}
+		std::cout << "MESH CACHE " << path << ": could not be written" << std::endl;
+		return false;
+	}
+
+	std::cout << "MESH CACHE " << path << ": written, " << _meshes.size() << " meshes, " << file.size() / (1024.0 * 1024.0) << " MB" << std::endl;
+	return true;
+}
+
+std::string MeshCache::GetCachePath(const std::string& source_path) {
+	return source_path + ".loglmesh";
+}
+
+uint64_t MeshCache::HashFile(const std::string& path) {
+	MappedFile file;
+	if (!file.Open(path)) {
+		return 0;
+	}
+
+	// FNV-1a over 8 byte words instead of bytes, the source can be tens of MB
+	const unsigned char* data = file.GetData();
+	size_t size = file.GetSize();
+	uint64_t hash = HashValue(FNV_OFFSET_BASIS, (uint64_t)size);
+	size_t word_count = size / sizeof(uint64_t);
+	for (size_t i = 0; i < word_count; i++) {
+		uint64_t word;
+		std::memcpy(&word, data + i * sizeof(uint64_t), sizeof(word));
+		hash = (hash ^ word) * FNV_PRIME;
+	}
+	return HashBytes(hash, data + word_count * sizeof(uint64_t), size - word_count * sizeof(uint64_t));
+}
+
+uint64_t MeshCache::HashOptions(const MeshOptions& options) {
+	uint64_t hash = FNV_OFFSET_BASIS;
+	hash = HashValue(hash, (uint32_t)options.Format);
+	hash = HashValue(hash, options.Optimize);
+	hash = HashValue(hash, options.MeshletTriangles);
+	hash = HashValue(hash, options.LodCount);
+	// an arena makes a model quantize all its meshes against the same bounds
+	hash = HashValue(hash, options.Arena != nullptr);
+	hash = HashValue(hash, options.HasQuantizationBounds);
+	if (options.HasQuantizationBounds) {
+		hash = HashValue(hash, options.QuantizationBounds.Min);
+		hash = HashValue(hash, options.QuantizationBounds.Max);
+	}
+	return hash;
+}
+
+MeshCache::MeshRecord MeshCache::ReadRecord(size_t index) const {
+	MeshRecord record;
+	std::memcpy(&record, _file.GetData() + _records_offset + index * sizeof(MeshRecord), sizeof(record));
+	return record;
+}
+
+bool MeshCache::ReadMaterials(size_t& offset, uint32_t material_count) {
+	const unsigned char* data = _file.GetData();
+
+	_materials.resize(material_count);
+	for (uint32_t i = 0; i < material_count; i++) {
+		uint32_t texture_count = 0;
+		if (!IsInFile(offset, sizeof(texture_count))) {
+			return false;
+		}
+		std::memcpy(&texture_count, data + offset, sizeof(texture_count));
+		offset += sizeof(texture_count);
+
+		for (uint32_t j = 0; j < texture_count; j++) {
+			std::string strings[2];
+			for (std::string& value : strings) {
+				uint32_t length = 0;
+				if (!IsInFile(offset, sizeof(length))) {
+					return false;
+				}
+				std::memcpy(&length, data + offset, sizeof(length));
+				offset += sizeof(length);
+				if (!IsInFile(offset, length)) {
+					return false;
+				}
+				value.assign((const char*)data + offset, length);
+				offset += length;
+			}
+			_materials[i].push_back(Texture(0, strings[0], strings[1]));
+		}
+	}
+	return true;
+}
+
+bool MeshCache::IsInFile(uint64_t offset, uint64_t size) const {
+	return offset <= _file.GetSize() && size <= _file.GetSize() - offset;
+}
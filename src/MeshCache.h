@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "Texture.h"
+
+// Cooked meshes of one model in a versioned binary file next to its source, e.g. sponza.obj.loglmesh.
+// A cache is only used when its version, the hash of the source file and the hash of the import options
+// all match, otherwise the model is imported again and the cache rewritten.
+//
+// Layout: FileHeader, the material table (per material a texture count, then type and path of each texture),
+// one MeshRecord per mesh, then the meshlet, level of detail, vertex and index blobs the records point at,
+// each 16 byte aligned. Vertex and index blobs are GPU ready and go to the driver straight from the mapping.
+class MeshCache {
+public:
+	static const uint32_t VERSION = 1;
+
+	MeshCache();
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	// maps and validates a cache, false when it is missing, truncated or stale
+	bool Open(const std::string& path, uint64_t source_hash, uint64_t options_hash);
+	void Close();
+	size_t GetMeshCount() const;
+	// vertex and index data point into the mapping and stay valid until Close
+	CookedMesh GetMesh(size_t index) const;
+	// the mesh's textures with Type and Path set, Id is left 0 for the caller to load
+	const std::vector<Texture>& GetTextures(size_t index) const;
+
+	// collects meshes while a model is imported, then writes them as a new cache
+	void Add(CookedMesh mesh, const std::vector<Texture>& textures);
+	bool Write(const std::string& path, uint64_t source_hash, uint64_t options_hash) const;
+
+	static std::string GetCachePath(const std::string& source_path);
+	// 0 when the file cannot be read
+	static uint64_t HashFile(const std::string& path);
+	// everything in the options that changes the cooked result
+	static uint64_t HashOptions(const MeshOptions& options);
+
+private:
+	struct FileHeader {
+		char Magic[8];
+		uint32_t Version;
+		uint32_t MeshCount;
+		uint64_t SourceHash;
+		uint64_t OptionsHash;
+		uint32_t MaterialCount;
+		uint32_t Reserved;
+	};
+
+	struct MeshRecord {
+		uint32_t Material;
+		uint32_t Format;
+		uint32_t VertexCount;
+		uint32_t VertexStride;
+		uint32_t IndexCount;
+		uint32_t GpuIndexCount;
+		uint32_t IndexType;
+		uint32_t IsOctahedral;
+		VertexQuantization Quantization;
+		Bounds MeshBounds;
+		uint32_t MeshletCount;
+		uint32_t LodCount;
+		uint64_t MeshletOffset;
+		uint64_t LodOffset;
+		uint64_t VertexOffset;
+		uint64_t IndexOffset;
+	};
+
+	MappedFile _file;
+	size_t _records_offset;
+	std::vector<std::vector<Texture>> _materials;
+	// material per mesh, for reading and writing alike
+	std::vector<uint32_t> _mesh_materials;
+	std::vector<CookedMesh> _meshes;
+
+	MeshRecord ReadRecord(size_t index) const;
+	bool ReadMaterials(size_t& offset, uint32_t material_count);
+	bool IsInFile(uint64_t offset, uint64_t size) const;
+};
@@ -0,0 +1,642 @@
+#include "MeshProcessing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+// Area weighted sum of squared distances to a set of planes, as the symmetric 4x4 matrix of Garland / Heckbert
+struct Quadric {
+	double A2, AB, AC, AD, B2, BC, BD, C2, CD, D2;
+	double Weight;
+};
+
+static Quadric MakePlaneQuadric(const glm::dvec3& normal, double distance, double weight) {
+	Quadric quadric;
+	quadric.A2 = normal.x * normal.x * weight;
+	quadric.AB = normal.x * normal.y * weight;
+	quadric.AC = normal.x * normal.z * weight;
+	quadric.AD = normal.x * distance * weight;
+	quadric.B2 = normal.y * normal.y * weight;
+	quadric.BC = normal.y * normal.z * weight;
+	quadric.BD = normal.y * distance * weight;
+	quadric.C2 = normal.z * normal.z * weight;
+	quadric.CD = normal.z * distance * weight;
+	quadric.D2 = distance * distance * weight;
+	quadric.Weight = weight;
+	return quadric;
+}
+
+static void AddQuadric(Quadric& quadric, const Quadric& other) {
+	quadric.A2 += other.A2;
+	quadric.AB += other.AB;
+	quadric.AC += other.AC;
+	quadric.AD += other.AD;
+	quadric.B2 += other.B2;
+	quadric.BC += other.BC;
+	quadric.BD += other.BD;
+	quadric.C2 += other.C2;
+	quadric.CD += other.CD;
+	quadric.D2 += other.D2;
+	quadric.Weight += other.Weight;
+}
+
+static double EvaluateQuadric(const Quadric& quadric, const glm::dvec3& point) {
+	return point.x * point.x * quadric.A2 + point.y * point.y * quadric.B2 + point.z * point.z * quadric.C2 +
+		2.0 * (point.x * point.y * quadric.AB + point.x * point.z * quadric.AC + point.y * point.z * quadric.BC) +
+		2.0 * (point.x * quadric.AD + point.y * quadric.BD + point.z * quadric.CD) + quadric.D2;
+}
+
+std::vector<MeshGeometry> MeshProcessing::SplitByVertexCount(std::vector<Vertex> vertices, std::vector<unsigned int> indices, unsigned int max_vertices) {
+	std::vector<MeshGeometry> parts;
+
+	if (vertices.size() <= max_vertices) {
+		parts.push_back({ std::move(vertices), std::move(indices) });
+		return parts;
+	}
+
+	const unsigned int NOT_IN_PART = 0xFFFFFFFF;
+
+	// source vertex -> vertex of the part being built
+	std::vector<unsigned int> remap(vertices.size(), NOT_IN_PART);
+	std::vector<unsigned int> part_sources;
+	part_sources.reserve(max_vertices);
+
+	MeshGeometry part;
+	part.Vertices.reserve(max_vertices);
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		unsigned int new_vertex_count = 0;
+		for (size_t j = 0; j < 3; j++) {
+			if (remap[indices[i + j]] == NOT_IN_PART) {
+				new_vertex_count++;
+			}
+		}
+
+		if (part.Vertices.size() + new_vertex_count > max_vertices) {
+			for (unsigned int source : part_sources) {
+				remap[source] = NOT_IN_PART;
+			}
+			part_sources.clear();
+
+			parts.push_back(std::move(part));
+			part = MeshGeometry();
+			part.Vertices.reserve(std::min((size_t)max_vertices, vertices.size()));
+		}
+
+		for (size_t j = 0; j < 3; j++) {
+			unsigned int source = indices[i + j];
+			if (remap[source] == NOT_IN_PART) {
+				remap[source] = (unsigned int)part.Vertices.size();
+				part.Vertices.push_back(vertices[source]);
+				part_sources.push_back(source);
+			}
+			part.Indices.push_back(remap[source]);
+		}
+	}
+
+	if (!part.Indices.empty()) {
+		parts.push_back(std::move(part));
+	}
+
+	return parts;
+}
+
+void MeshProcessing::Optimize(MeshGeometry& geometry, const std::string& name) {
+	VertexCacheStats before = AnalyzeVertexCache(geometry.Indices, geometry.Vertices.size());
+
+	OptimizeVertexCache(geometry.Indices, geometry.Vertices.size());
+	OptimizeOverdraw(geometry.Indices, geometry.Vertices);
+	OptimizeVertexFetch(geometry.Vertices, geometry.Indices);
+
+	VertexCacheStats after = AnalyzeVertexCache(geometry.Indices, geometry.Vertices.size());
+
+	// built first and written at once, meshes are optimized on several threads at the same time
+	std::ostringstream report;
+	report << "OPTIMIZE " << name << ": ACMR " << before.Acmr << " -> " << after.Acmr
+		<< ", ATVR " << before.Atvr << " -> " << after.Atvr << "\n";
+	std::cout << report.str() << std::flush;
+}
+
+void MeshProcessing::OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertex_count) {
+	size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0 || vertex_count == 0) {
+		return;
+	}
+
+	// vertex -> triangles adjacency, flattened
+	std::vector<unsigned int> live_triangles(vertex_count, 0);
+	for (unsigned int index : indices) {
+		live_triangles[index]++;
+	}
+
+	std::vector<unsigned int> adjacency_offsets(vertex_count + 1, 0);
+	for (size_t i = 0; i < vertex_count; i++) {
+		adjacency_offsets[i + 1] = adjacency_offsets[i] + live_triangles[i];
+	}
+
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> adjacency_fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacency[adjacency_fill[indices[i]]++] = (unsigned int)(i / 3);
+	}
+
+	std::vector<unsigned int> cache_time(vertex_count, 0);
+	std::vector<unsigned int> dead_end_stack;
+	dead_end_stack.reserve(indices.size());
+	std::vector<bool> is_emitted(triangle_count, false);
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+
+	std::vector<unsigned int> candidates;
+	candidates.reserve(64);
+
+	unsigned int time_stamp = CACHE_SIZE + 1;
+	size_t cursor = 0;
+
+	// next vertex with live triangles, first from the dead end stack then in input order
+	auto skip_dead_end = [&]() -> long long {
+		while (!dead_end_stack.empty()) {
+			unsigned int vertex = dead_end_stack.back();
+			dead_end_stack.pop_back();
+			if (live_triangles[vertex] > 0) {
+				return vertex;
+			}
+		}
+		while (cursor < vertex_count) {
+			if (live_triangles[cursor] > 0) {
+				return (long long)cursor;
+			}
+			cursor++;
+		}
+		return -1;
+	};
+
+	long long fanning_vertex = skip_dead_end();
+	while (fanning_vertex >= 0) {
+		candidates.clear();
+
+		for (unsigned int a = adjacency_offsets[fanning_vertex]; a < adjacency_offsets[fanning_vertex + 1]; a++) {
+			unsigned int triangle = adjacency[a];
+			if (is_emitted[triangle]) {
+				continue;
+			}
+
+			for (unsigned int j = 0; j < 3; j++) {
+				unsigned int vertex = indices[triangle * 3 + j];
+				output.push_back(vertex);
+				dead_end_stack.push_back(vertex);
+				candidates.push_back(vertex);
+				live_triangles[vertex]--;
+				if (time_stamp - cache_time[vertex] > CACHE_SIZE) {
+					cache_time[vertex] = time_stamp++;
+				}
+			}
+			is_emitted[triangle] = true;
+		}
+
+		// pick the candidate that will still be in the cache once its remaining triangles are emitted
+		long long best_vertex = -1;
+		int best_priority = -1;
+		for (unsigned int vertex : candidates) {
+			if (live_triangles[vertex] == 0) {
+				continue;
+			}
+			int priority = 0;
+			if (time_stamp - cache_time[vertex] + 2 * live_triangles[vertex] <= CACHE_SIZE) {
+				priority = (int)(time_stamp - cache_time[vertex]);
+			}
+			if (priority > best_priority) {
+				best_priority = priority;
+				best_vertex = vertex;
+			}
+		}
+
+		fanning_vertex = best_vertex >= 0 ? best_vertex : skip_dead_end();
+	}
+
+	indices.swap(output);
+}
+
+void MeshProcessing::OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold) {
+	size_t triangle_count = indices.size() / 3;
+	if (triangle_count < 2) {
+		return;
+	}
+
+	// hard boundaries: a triangle that misses on all three vertices starts over with a cold cache,
+	// so clusters split there can be reordered without hurting the vertex cache
+	std::vector<unsigned int> cluster_starts;
+	{
+		std::vector<unsigned int> cache_time(vertices.size(), 0);
+		unsigned int time_stamp = CACHE_SIZE + 1;
+		for (size_t i = 0; i < triangle_count; i++) {
+			unsigned int misses = 0;
+			for (size_t j = 0; j < 3; j++) {
+				unsigned int vertex = indices[i * 3 + j];
+				if (time_stamp - cache_time[vertex] > CACHE_SIZE) {
+					cache_time[vertex] = time_stamp++;
+					misses++;
+				}
+			}
+			if (i == 0 || misses == 3) {
+				cluster_starts.push_back((unsigned int)i);
+			}
+		}
+	}
+
+	size_t cluster_count = cluster_starts.size();
+	if (cluster_count < 2) {
+		return;
+	}
+
+	glm::vec3 mesh_centroid = glm::vec3(0.0f);
+	for (const Vertex& vertex : vertices) {
+		mesh_centroid += vertex.Position;
+	}
+	mesh_centroid /= (float)vertices.size();
+
+	// clusters facing away from the mesh center are likely to occlude the rest, draw them first
+	std::vector<float> sort_keys(cluster_count);
+	for (size_t c = 0; c < cluster_count; c++) {
+		size_t first = cluster_starts[c];
+		size_t last = c + 1 < cluster_count ? cluster_starts[c + 1] : triangle_count;
+
+		glm::vec3 centroid = glm::vec3(0.0f);
+		glm::vec3 normal = glm::vec3(0.0f);
+		float area = 0.0f;
+		for (size_t i = first; i < last; i++) {
+			const glm::vec3& p0 = vertices[indices[i * 3 + 0]].Position;
+			const glm::vec3& p1 = vertices[indices[i * 3 + 1]].Position;
+			const glm::vec3& p2 = vertices[indices[i * 3 + 2]].Position;
+			glm::vec3 face_normal = glm::cross(p1 - p0, p2 - p0);
+			float face_area = glm::length(face_normal);
+			centroid += (p0 + p1 + p2) * (face_area / 3.0f);
+			normal += face_normal;
+			area += face_area;
+		}
+		if (area > 0.0f) {
+			centroid /= area;
+		}
+		float normal_length = glm::length(normal);
+		if (normal_length > 0.0f) {
+			normal /= normal_length;
+		}
+		sort_keys[c] = glm::dot(centroid - mesh_centroid, normal);
+	}
+
+	std::vector<unsigned int> cluster_order(cluster_count);
+	for (size_t c = 0; c < cluster_count; c++) {
+		cluster_order[c] = (unsigned int)c;
+	}
+	std::stable_sort(cluster_order.begin(), cluster_order.end(), [&](unsigned int a, unsigned int b) {
+		return sort_keys[a] > sort_keys[b];
+	});
+
+	std::vector<unsigned int> sorted;
+	sorted.reserve(indices.size());
+	for (unsigned int c : cluster_order) {
+		size_t first = cluster_starts[c];
+		size_t last = c + 1 < cluster_count ? cluster_starts[c + 1] : triangle_count;
+		sorted.insert(sorted.end(), indices.begin() + first * 3, indices.begin() + last * 3);
+	}
+
+	float acmr_before = AnalyzeVertexCache(indices, vertices.size()).Acmr;
+	float acmr_after = AnalyzeVertexCache(sorted, vertices.size()).Acmr;
+	if (acmr_after <= acmr_before * threshold) {
+		indices.swap(sorted);
+	}
+}
+
+void MeshProcessing::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	const unsigned int NOT_REMAPPED = 0xFFFFFFFF;
+
+	std::vector<unsigned int> remap(vertices.size(), NOT_REMAPPED);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (unsigned int& index : indices) {
+		if (remap[index] == NOT_REMAPPED) {
+			remap[index] = (unsigned int)reordered.size();
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+}
+
+std::vector<Meshlet> MeshProcessing::BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int max_triangles) {
+	std::vector<Meshlet> meshlets;
+	if (max_triangles == 0) {
+		return meshlets;
+	}
+
+	// normals that spread wider than this (cosine to the axis) give a cone that can never be culled
+	const float MIN_CONE_DOT = 0.1f;
+
+	size_t meshlet_index_count = (size_t)max_triangles * 3;
+	size_t triangle_index_count = indices.size() - indices.size() % 3;
+	meshlets.reserve((triangle_index_count + meshlet_index_count - 1) / meshlet_index_count);
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	positions.reserve(meshlet_index_count);
+	normals.reserve(max_triangles);
+
+	for (size_t offset = 0; offset < triangle_index_count; offset += meshlet_index_count) {
+		size_t end = std::min(offset + meshlet_index_count, triangle_index_count);
+
+		positions.clear();
+		normals.clear();
+		glm::vec3 normal_sum = glm::vec3(0.0f);
+		for (size_t i = offset; i < end; i += 3) {
+			glm::vec3 a = vertices[indices[i]].Position;
+			glm::vec3 b = vertices[indices[i + 1]].Position;
+			glm::vec3 c = vertices[indices[i + 2]].Position;
+			positions.push_back(a);
+			positions.push_back(b);
+			positions.push_back(c);
+
+			// degenerate triangles have no facing and do not constrain the cone
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float length = glm::length(normal);
+			if (length > 0.0f) {
+				normals.push_back(normal / length);
+				normal_sum += normal / length;
+			}
+		}
+
+		Meshlet meshlet;
+		meshlet.IndexOffset = (unsigned int)offset;
+		meshlet.IndexCount = (unsigned int)(end - offset);
+		meshlet.Sphere = Bounds::FromPoints(positions, [](const glm::vec3& position) { return position; }).Sphere;
+		meshlet.ConeAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+		meshlet.ConeCutoff = 1.0f;
+
+		float sum_length = glm::length(normal_sum);
+		if (sum_length > 0.0f) {
+			meshlet.ConeAxis = normal_sum / sum_length;
+
+			float min_dot = 1.0f;
+			for (const glm::vec3& normal : normals) {
+				min_dot = std::min(min_dot, glm::dot(normal, meshlet.ConeAxis));
+			}
+
+			if (min_dot > MIN_CONE_DOT) {
+				// the normal cone widened by 90 degrees on each side and inverted, -cos(a + 90) = sin(a)
+				meshlet.ConeCutoff = std::sqrt(1.0f - min_dot * min_dot);
+			}
+		}
+
+		meshlets.push_back(meshlet);
+	}
+
+	return meshlets;
+}
+
+VertexCacheStats MeshProcessing::AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertex_count) {
+	VertexCacheStats stats = { 0.0f, 0.0f };
+	if (indices.empty() || vertex_count == 0) {
+		return stats;
+	}
+
+	std::vector<unsigned int> cache_time(vertex_count, 0);
+	std::vector<bool> is_referenced(vertex_count, false);
+	unsigned int time_stamp = CACHE_SIZE + 1;
+	size_t misses = 0;
+	size_t referenced_count = 0;
+
+	for (unsigned int index : indices) {
+		if (time_stamp - cache_time[index] > CACHE_SIZE) {
+			cache_time[index] = time_stamp++;
+			misses++;
+		}
+		if (!is_referenced[index]) {
+			is_referenced[index] = true;
+			referenced_count++;
+		}
+	}
+
+	stats.Acmr = (float)misses / (float)(indices.size() / 3);
+	stats.Atvr = (float)misses / (float)referenced_count;
+	return stats;
+}
+
+std::vector<unsigned int> MeshProcessing::Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t target_index_count, float max_error, float& error) {
+	error = 0.0f;
+	std::vector<unsigned int> result(indices.begin(), indices.end() - indices.size() % 3);
+	size_t vertex_count = vertices.size();
+	if (result.size() <= target_index_count || vertex_count == 0) {
+		return result;
+	}
+
+	// vertices sharing a position (attribute seams) all map to the first of them in position order
+	std::vector<unsigned int> sorted_vertices(vertex_count);
+	for (size_t i = 0; i < vertex_count; i++) {
+		sorted_vertices[i] = (unsigned int)i;
+	}
+	std::sort(sorted_vertices.begin(), sorted_vertices.end(), [&vertices](unsigned int a, unsigned int b) {
+		const glm::vec3& pa = vertices[a].Position;
+		const glm::vec3& pb = vertices[b].Position;
+		return pa.x != pb.x ? pa.x < pb.x : (pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z);
+	});
+
+	std::vector<unsigned int> position_ids(vertex_count);
+	std::vector<unsigned int> position_copies(vertex_count, 0);
+	for (size_t i = 0; i < vertex_count; i++) {
+		unsigned int vertex = sorted_vertices[i];
+		bool is_new_position = i == 0 || vertices[vertex].Position != vertices[sorted_vertices[i - 1]].Position;
+		position_ids[vertex] = is_new_position ? vertex : position_ids[sorted_vertices[i - 1]];
+		position_copies[position_ids[vertex]]++;
+	}
+
+	// seam vertices would tear their copies apart if they moved
+	std::vector<unsigned char> is_locked(vertex_count, 0);
+	for (size_t i = 0; i < vertex_count; i++) {
+		if (position_copies[position_ids[i]] > 1) {
+			is_locked[i] = 1;
+		}
+	}
+
+	// edges used by exactly two triangles are interior, the rest are borders or non manifold and stay in place
+	std::vector<std::pair<unsigned int, unsigned int>> edges;
+	edges.reserve(result.size());
+	for (size_t i = 0; i < result.size(); i += 3) {
+		for (size_t j = 0; j < 3; j++) {
+			unsigned int a = position_ids[result[i + j]];
+			unsigned int b = position_ids[result[i + (j + 1) % 3]];
+			edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size();) {
+		size_t run_end = i;
+		while (run_end < edges.size() && edges[run_end] == edges[i]) {
+			run_end++;
+		}
+		// unlocked vertices have a single copy, so the position id is the vertex itself
+		if (run_end - i != 2) {
+			is_locked[edges[i].first] = 1;
+			is_locked[edges[i].second] = 1;
+		}
+		i = run_end;
+	}
+
+	std::vector<Quadric> quadrics(vertex_count, MakePlaneQuadric(glm::dvec3(0.0), 0.0, 0.0));
+	for (size_t i = 0; i < result.size(); i += 3) {
+		glm::dvec3 p0 = glm::dvec3(vertices[result[i]].Position);
+		glm::dvec3 p1 = glm::dvec3(vertices[result[i + 1]].Position);
+		glm::dvec3 p2 = glm::dvec3(vertices[result[i + 2]].Position);
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double length = glm::length(normal);
+		if (length == 0.0) {
+			continue;
+		}
+		normal /= length;
+
+		Quadric plane = MakePlaneQuadric(normal, -glm::dot(normal, p0), length * 0.5);
+		for (size_t j = 0; j < 3; j++) {
+			AddQuadric(quadrics[position_ids[result[i + j]]], plane);
+		}
+	}
+
+	struct Collapse {
+		unsigned int From;
+		unsigned int To;
+		double Cost;
+	};
+
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> remap(vertex_count);
+	std::vector<unsigned char> is_touched(vertex_count);
+	std::vector<unsigned int> triangle_offsets(vertex_count + 1);
+	std::vector<unsigned int> vertex_triangles;
+
+	size_t triangle_count = result.size() / 3;
+	size_t target_triangle_count = target_index_count / 3;
+	double max_error_squared = (double)max_error * max_error;
+	double error_squared = 0.0;
+
+	// each pass collapses the cheapest edges whose neighbourhoods do not overlap, then rewrites the indices
+	while (triangle_count > target_triangle_count) {
+		std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+		for (unsigned int index : result) {
+			triangle_offsets[index + 1]++;
+		}
+		for (size_t i = 0; i < vertex_count; i++) {
+			triangle_offsets[i + 1] += triangle_offsets[i];
+		}
+		vertex_triangles.resize(result.size());
+		std::vector<unsigned int> cursor(triangle_offsets.begin(), triangle_offsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++) {
+			vertex_triangles[cursor[result[i]]++] = (unsigned int)(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (size_t j = 0; j < 3; j++) {
+				unsigned int a = result[i + j];
+				unsigned int b = result[i + (j + 1) % 3];
+				unsigned int directions[2][2] = { { a, b }, { b, a } };
+				for (const auto& direction : directions) {
+					unsigned int from = direction[0];
+					unsigned int to = direction[1];
+					if (is_locked[from] || from == to) {
+						continue;
+					}
+
+					const Quadric& from_quadric = quadrics[from];
+					const Quadric& to_quadric = quadrics[position_ids[to]];
+					glm::dvec3 target = glm::dvec3(vertices[to].Position);
+					double weight = std::max(from_quadric.Weight + to_quadric.Weight, 1e-12);
+					double cost = (EvaluateQuadric(from_quadric, target) + EvaluateQuadric(to_quadric, target)) / weight;
+					collapses.push_back({ from, to, std::max(cost, 0.0) });
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Cost < b.Cost; });
+
+		std::fill(is_touched.begin(), is_touched.end(), 0);
+		for (size_t i = 0; i < vertex_count; i++) {
+			remap[i] = (unsigned int)i;
+		}
+
+		size_t collapse_count = 0;
+		for (const Collapse& collapse : collapses) {
+			if (triangle_count <= target_triangle_count || collapse.Cost > max_error_squared) {
+				break;
+			}
+			if (is_touched[collapse.From] || is_touched[collapse.To]) {
+				continue;
+			}
+
+			// triangles around From must keep facing the same way once From sits on To
+			bool is_flipping = false;
+			size_t removed_count = 0;
+			glm::vec3 to_position = vertices[collapse.To].Position;
+			for (unsigned int k = triangle_offsets[collapse.From]; k < triangle_offsets[collapse.From + 1]; k++) {
+				const unsigned int* triangle = &result[vertex_triangles[k] * 3];
+				if (triangle[0] == collapse.To || triangle[1] == collapse.To || triangle[2] == collapse.To) {
+					removed_count++;
+					continue;
+				}
+
+				glm::vec3 p[3];
+				glm::vec3 moved[3];
+				for (size_t j = 0; j < 3; j++) {
+					p[j] = vertices[triangle[j]].Position;
+					moved[j] = triangle[j] == collapse.From ? to_position : p[j];
+				}
+				glm::vec3 old_normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+				glm::vec3 new_normal = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+				if (glm::dot(old_normal, new_normal) <= 0.0f) {
+					is_flipping = true;
+					break;
+				}
+			}
+			if (is_flipping) {
+				continue;
+			}
+
+			remap[collapse.From] = collapse.To;
+			AddQuadric(quadrics[position_ids[collapse.To]], quadrics[collapse.From]);
+			triangle_count -= removed_count;
+			error_squared = std::max(error_squared, collapse.Cost);
+			collapse_count++;
+
+			// the neighbourhood is stale until the indices are rewritten
+			for (unsigned int k = triangle_offsets[collapse.From]; k < triangle_offsets[collapse.From + 1]; k++) {
+				const unsigned int* triangle = &result[vertex_triangles[k] * 3];
+				is_touched[triangle[0]] = 1;
+				is_touched[triangle[1]] = 1;
+				is_touched[triangle[2]] = 1;
+			}
+		}
+
+		if (collapse_count == 0) {
+			break;
+		}
+
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			unsigned int a = remap[result[i]];
+			unsigned int b = remap[result[i + 1]];
+			unsigned int c = remap[result[i + 2]];
+			if (a != b && b != c && a != c) {
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+		triangle_count = result.size() / 3;
+	}
+
+	error = (float)std::sqrt(error_squared);
+	return result;
+}
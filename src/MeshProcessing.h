@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "Vertex.h"
+
+// CPU side geometry of a mesh before it is handed to Mesh for upload
+struct MeshGeometry {
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+};
+
+// Post-transform vertex cache efficiency of an index order, simulated with a FIFO cache
+struct VertexCacheStats {
+	// average cache miss ratio: transformed vertices per triangle, 0.5 is ideal for large grids, 3 is worst
+	float Acmr;
+	// average transform to vertex ratio: transformed vertices per unique vertex, 1 is ideal
+	float Atvr;
+};
+
+// A contiguous run of triangles in a mesh's index buffer with the bounds needed to cull it on its own
+struct Meshlet {
+	unsigned int IndexOffset;
+	unsigned int IndexCount;
+	BoundingSphere Sphere;
+	// every triangle normal lies within the cone around ConeAxis, a cutoff of 1 means the cone is too wide to ever cull
+	glm::vec3 ConeAxis;
+	float ConeCutoff;
+
+	// true when every triangle faces away from a viewer at view_position (Barczak / meshoptimizer cone test)
+	bool IsBackFacing(const glm::vec3& view_position) const {
+		glm::vec3 offset = Sphere.Center - view_position;
+		return glm::dot(offset, ConeAxis) >= ConeCutoff * glm::length(offset) + Sphere.Radius;
+	}
+};
+
+// Import time geometry passes that run between the importer / terrain generator and Mesh
+class MeshProcessing {
+public:
+	// Splits a triangle list into parts that reference at most max_vertices vertices each,
+	// so every part can be drawn with 16 bit indices. Geometry that already fits is moved through untouched.
+	static std::vector<MeshGeometry> SplitByVertexCount(std::vector<Vertex> vertices, std::vector<unsigned int> indices, unsigned int max_vertices);
+
+	// Runs the vertex cache, overdraw and vertex fetch passes below in that order and prints ACMR / ATVR before and after
+	static void Optimize(MeshGeometry& geometry, const std::string& name);
+
+	// Tipsify (Sander et al. 2007): reorders triangles for post-transform vertex cache locality
+	static void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertex_count);
+	// Reorders the clusters of a cache optimized index list so outward facing clusters come first,
+	// as long as ACMR stays within threshold times the incoming ACMR
+	static void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+	// Reorders vertices by first use so vertex fetch walks memory linearly, drops unreferenced vertices
+	static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	// Cuts the index list into meshlets of up to max_triangles consecutive triangles. Run it on cache optimized
+	// indices, whose triangle order is already spatially coherent, so the meshlets come out compact.
+	static std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int max_triangles);
+
+	// Quadric error metric simplification (Garland / Heckbert 1997) by collapsing vertices onto neighbours.
+	// Returns indices over the same vertices with at most target_index_count indices, or as close as max_error
+	// (object space distance) allows. Vertices on open borders and attribute seams never move, so the result has
+	// no cracks. error receives the largest distance a collapse moved the surface.
+	static std::vector<unsigned int> Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t target_index_count, float max_error, float& error);
+
+	static VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertex_count);
+
+private:
+	// size of the simulated post-transform cache
+	static const unsigned int CACHE_SIZE = 16;
+};
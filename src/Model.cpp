@@ -1,119 +1,624 @@
 #include "Model.h"
 
-Model::Model() {
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <sstream>
+
+#include "MappedFile.h"
+#include "MemoryStats.h"
+#include "MeshProcessing.h"
+#include "TextureCooker.h"
+#include "TextureDecodeBatch.h"
+#include "ThreadPool.h"
+
+// the import (or mapped cache) of a model, handed from the thread that built it to the GL thread that uploads it
+struct Model::PendingLoad {
+	std::string Path;
+	// with the quantization bounds of the import filled in
+	MeshOptions Options;
+	std::vector<ConvertedMesh> Meshes;
+	// type and path of each mesh's textures
+	std::vector<std::vector<Texture>> MeshTextures;
+	// every path the meshes use once, decoded on the thread pool unless the texture cache had it at import time
+	std::vector<std::string> ImagePaths;
+	std::vector<std::string> CanonicalImagePaths;
+	std::vector<uint64_t> ImageHashes;
+	std::vector<bool> IsDecoding;
+	TextureDecodeBatch Decodes;
+	size_t NextImage = 0;
+	size_t NextMesh = 0;
+	// with Options.Staging, the images whose pixels are queued there and the last ticket of the load
+	std::vector<TextureImage> StagedImages;
+	uint64_t LastTicket = 0;
+
+	// the cache the meshes were mapped from, or the one they are collected in when IsCached is false,
+	// null when the model cannot be cached
+	std::shared_ptr<MeshCache> Cache;
+	bool IsCached = false;
+	std::string CachePath;
+	uint64_t SourceHash = 0;
+	uint64_t OptionsHash = 0;
+
+	~PendingLoad() {
+		for (TextureImage& image : StagedImages) {
+			Texture::Free(image);
+		}
+	}
+};
+
+Model::Model() : _is_resident(true) {
 }
 
-Model::Model(std::vector<Mesh> meshes) {
-	this->_meshes = meshes;
+Model::Model(std::vector<Mesh> meshes) : _is_resident(true) {
+	this->_meshes = std::move(meshes);
+	ComputeBounds();
+	ReserveDrawList();
 }
 
-Model::Model(std::string path, bool load_immediately) {
+Model::Model(std::string path, bool load_immediately, MeshOptions options) : _source_path(path), _is_resident(false), _options(options) {
 	if (load_immediately) {
-		Load(path);
+		Load();
 	}
 }
 
-void Model::Draw(Shader shader) {
-	for (auto mesh : _meshes) {
+void Model::Load() {
+	ScopedLoadReport load_report(_source_path);
+	std::shared_ptr<PendingLoad> load = Import(_source_path, _options);
+	Upload(*load, std::chrono::steady_clock::time_point::max());
+}
+
+bool Model::IsResident() const {
+	return _is_resident;
+}
+
+const std::string& Model::GetSourcePath() const {
+	return _source_path;
+}
+
+const MeshOptions& Model::GetOptions() const {
+	return _options;
+}
+
+void Model::Draw(const Shader& shader) const {
+	if (!_is_resident) {
+		return;
+	}
+	for (const Mesh& mesh : _meshes) {
 		mesh.Draw(shader);
 	}
 }
 
-void Model::Load(std::string path) {
+void Model::DrawInstanced(const Shader& shader, const InstanceBuffer& instances) const {
+	if (!_is_resident) {
+		return;
+	}
+	for (const Mesh& mesh : _meshes) {
+		mesh.DrawInstanced(shader, instances);
+	}
+}
+
+void Model::Submit(RenderQueue& queue, const Shader& shader, const glm::mat4& model_matrix, const DrawView& view, CullingStats& stats) const {
+	if (!_is_resident) {
+		return;
+	}
+
+	// one transform of the view instead of one per mesh and meshlet bound
+	DrawView object_view = view.ToObjectSpace(model_matrix);
+
+	// the whole model is out of view, skip the per mesh tests
+	if (!object_view.ViewFrustum.Intersects(_bounds.Sphere)) {
+		stats.Culled += (unsigned int)_meshes.size();
+		return;
+	}
+
+	unsigned int transform = queue.AddTransform(model_matrix);
+	for (const Mesh& mesh : _meshes) {
+		size_t first_range = queue.GetRanges().Size();
+		if (mesh.Cull(object_view, stats, queue.GetRanges()) > 0) {
+			glm::vec3 center = glm::vec3(model_matrix * glm::vec4(mesh.GetBounds().Sphere.Center, 1.0f));
+			queue.Add(shader, mesh, transform, first_range, glm::length(center - view.Position));
+		}
+	}
+}
+
+void Model::Cull(const glm::mat4& model_matrix, const DrawView& view, CullingStats& stats) const {
+	if (!_is_resident) {
+		return;
+	}
+	DrawView object_view = view.ToObjectSpace(model_matrix);
+
+	if (!object_view.ViewFrustum.Intersects(_bounds.Sphere)) {
+		stats.Culled += (unsigned int)_meshes.size();
+		return;
+	}
+
+	for (const Mesh& mesh : _meshes) {
+		_draw_list.Clear();
+		mesh.Cull(object_view, stats, _draw_list);
+	}
+}
+
+const Bounds& Model::GetBounds() const {
+	return _bounds;
+}
+
+unsigned int Model::GetTriangleCount() const {
+	unsigned int count = 0;
+	for (const Mesh& mesh : _meshes) {
+		count += mesh.GetTriangleCount();
+	}
+	return count;
+}
+
+unsigned int Model::GetMeshletCount() const {
+	unsigned int count = 0;
+	for (const Mesh& mesh : _meshes) {
+		count += (unsigned int)mesh.GetMeshlets().size();
+	}
+	return count;
+}
+
+size_t Model::GetCpuBytes() const {
+	size_t bytes = 0;
+	for (const Mesh& mesh : _meshes) {
+		bytes += mesh.GetCpuBytes();
+	}
+	return bytes;
+}
+
+size_t Model::GetGpuBytes() const {
+	size_t bytes = 0;
+	for (const Mesh& mesh : _meshes) {
+		bytes += mesh.GetGpuBytes();
+	}
+	return bytes;
+}
+
+size_t Model::GetIndexBytesSaved() const {
+	size_t bytes = 0;
+	for (const Mesh& mesh : _meshes) {
+		bytes += mesh.GetIndexBytesSaved();
+	}
+	return bytes;
+}
+
+void Model::PrintMemoryReport(const std::string& name) const {
+	std::cout << "MEMORY " << name << ": " << _meshes.size() << " meshes, " << GetMeshletCount() << " meshlets, geometry CPU "
+		<< GetCpuBytes() / (1024.0 * 1024.0) << " MB, GPU " << GetGpuBytes() / (1024.0 * 1024.0) << " MB, "
+		<< GetIndexBytesSaved() / (1024.0 * 1024.0) << " MB saved by 16 bit indices" << std::endl;
+}
+
+std::shared_ptr<Model::PendingLoad> Model::Import(const std::string& path, const MeshOptions& options) {
+	std::shared_ptr<PendingLoad> load = std::make_shared<PendingLoad>();
+	load->Path = path;
+	load->Options = options;
+
+	// a cooked mesh keeps nothing on the CPU, so the cache can only stand in for DropAfterUpload
+	bool use_cache = options.Residency == GeometryResidency::DropAfterUpload;
+	load->CachePath = MeshCache::GetCachePath(path);
+	if (use_cache) {
+		load->SourceHash = MeshCache::HashFile(path);
+		load->OptionsHash = MeshCache::HashOptions(options);
+		load->Cache = std::make_shared<MeshCache>();
+		if (load->Cache->Open(load->CachePath, load->SourceHash, load->OptionsHash)) {
+			// the mapped pages go to the driver as they are, the mapping is closed once everything is uploaded
+			load->IsCached = true;
+			load->Meshes.resize(load->Cache->GetMeshCount());
+			for (size_t i = 0; i < load->Cache->GetMeshCount(); i++) {
+				load->Meshes[i].Cooked = load->Cache->GetMesh(i);
+				load->MeshTextures.push_back(load->Cache->GetTextures(i));
+			}
+			DecodeTextures(*load, load->MeshTextures);
+			return load;
+		}
+		if (load->SourceHash == 0) {
+			load->Cache.reset();
+		}
+	}
+
 	Assimp::Importer importer;
 	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+	if (scene == nullptr) {
+		std::cout << "IMPORT " << path << ": " << importer.GetErrorString() << std::endl;
+		load->Cache.reset();
+		return load;
+	}
+
+	// meshes sharing an arena can only be batched when they decode positions the same way
+	if (load->Options.Arena != nullptr && !load->Options.HasQuantizationBounds) {
+		BoundingBox box;
+		box.Min = glm::vec3(std::numeric_limits<float>::max());
+		box.Max = glm::vec3(-std::numeric_limits<float>::max());
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+			const aiMesh* mesh = scene->mMeshes[i];
+			for (unsigned int j = 0; j < mesh->mNumVertices; j++) {
+				glm::vec3 position(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z);
+				box.Min = glm::min(box.Min, position);
+				box.Max = glm::max(box.Max, position);
+			}
+		}
+		load->Options.QuantizationBounds = box;
+		load->Options.HasQuantizationBounds = true;
+	}
+
+	std::vector<const aiMesh*> scene_meshes;
+	CollectMeshes(scene->mRootNode, scene, scene_meshes);
+
+	std::vector<std::vector<Texture>> scene_textures(scene_meshes.size());
+	for (size_t i = 0; i < scene_meshes.size(); i++) {
+		if (scene_meshes[i]->mMaterialIndex >= 0) {
+			const aiMaterial* material = scene->mMaterials[scene_meshes[i]->mMaterialIndex];
+			std::vector<Texture> diffuse_maps = GetMaterialTextures(material, aiTextureType_DIFFUSE, "diffuse");
+			scene_textures[i].insert(scene_textures[i].end(), diffuse_maps.begin(), diffuse_maps.end());
+			std::vector<Texture> specular_maps = GetMaterialTextures(material, aiTextureType_SPECULAR, "specular");
+			scene_textures[i].insert(scene_textures[i].end(), specular_maps.begin(), specular_maps.end());
+		}
+	}
+	// the images decode while the meshes convert
+	DecodeTextures(*load, scene_textures);
 
-	_path = path.substr(0, path.find_last_of('/'));
-	
-	ProcessNode(scene->mRootNode, scene);
+	std::vector<std::vector<ConvertedMesh>> converted;
+	double convert_ms = ConvertMeshes(scene_meshes, load->Options, converted, load->Options.ImportThreads);
+	unsigned int thread_count = ThreadPool::GetShared().GetThreadCount();
+	if (load->Options.ImportThreads > 0 && load->Options.ImportThreads < thread_count) {
+		thread_count = load->Options.ImportThreads;
+	}
+	// written at once, several models can be imported at the same time
+	std::ostringstream report;
+	report << "IMPORT " << path << ": " << scene_meshes.size() << " meshes converted in " << convert_ms << " ms on "
+		<< thread_count << " threads\n";
+	std::cout << report.str() << std::flush;
+
+	for (size_t i = 0; i < scene_meshes.size(); i++) {
+		for (ConvertedMesh& part : converted[i]) {
+			load->Meshes.push_back(std::move(part));
+			load->MeshTextures.push_back(scene_textures[i]);
+		}
+	}
+	return load;
 }
 
-void Model::ProcessNode(aiNode* node, const aiScene* scene) {
+bool Model::Upload(PendingLoad& load, std::chrono::steady_clock::time_point deadline) {
+	if (load.NextImage == 0 && load.NextMesh == 0) {
+		_path = load.Path.substr(0, load.Path.find_last_of('/'));
+		_meshes.reserve(_meshes.size() + load.Meshes.size());
+	}
+
+	// without a deadline there is no later frame, so decodes are waited for
+	bool can_wait = deadline == std::chrono::steady_clock::time_point::max();
+	UploadRing* staging = load.Options.Staging;
+
+	// textures first so every mesh finds its own uploaded
+	do {
+		if (load.NextImage < load.ImagePaths.size()) {
+			// the texture cache had these at import time, nothing to wait for
+			if (!load.IsDecoding[load.NextImage]) {
+				TextureImage image;
+				AcquireTexture(load, load.NextImage, image);
+			}
+			load.NextImage++;
+		}
+		else if (load.Decodes.GetPendingCount() > 0) {
+			// in the order they finish decoding
+			DecodedTexture decoded;
+			if (!load.Decodes.Next(decoded, can_wait)) {
+				return false;
+			}
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			AcquireTexture(load, decoded.Index, decoded.Image);
+			double upload_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			std::cout << "TEXTURE " << load.ImagePaths[decoded.Index] << ": " << decoded.FileBytes / 1024 << " KB decoded in "
+				<< decoded.DecodeMilliseconds << " ms, uploaded in " << upload_ms << " ms" << std::endl;
+			if (load.Decodes.GetPendingCount() == 0) {
+				load.Decodes.PrintReport(load.Path);
+			}
+		}
+		else if (load.NextMesh < load.Meshes.size()) {
+			ConvertedMesh& part = load.Meshes[load.NextMesh];
+			std::vector<Texture> textures = ResolveTextures(load.MeshTextures[load.NextMesh]);
+			if (part.Vertices.empty()) {
+				_meshes.push_back(Mesh(part.Cooked, textures, load.Options));
+			}
+			else {
+				_meshes.push_back(Mesh(std::move(part.Vertices), std::move(part.Indices), part.Cooked, textures, load.Options));
+			}
+
+			if (load.Cache != nullptr && !load.IsCached) {
+				load.Cache->Add(std::move(part.Cooked), textures);
+			}
+			else if (staging == nullptr) {
+				// the packed copy is in GL buffers now
+				part = ConvertedMesh();
+			}
+			if (staging != nullptr) {
+				load.LastTicket = staging->GetLastTicket();
+			}
+			load.NextMesh++;
+		}
+		else if (staging != nullptr && !staging->IsIssued(load.LastTicket)) {
+			// the cache mapping and the staged data go with FinishLoad, so the copies have to be out first
+			if (!can_wait) {
+				return false;
+			}
+			staging->Flush();
+		}
+		else {
+			FinishLoad(load);
+			return true;
+		}
+	} while (std::chrono::steady_clock::now() < deadline);
+
+	return false;
+}
+
+void Model::FinishLoad(PendingLoad& load) {
+	_options = load.Options;
+	ComputeBounds();
+	ReserveDrawList();
+
+	if (load.IsCached) {
+		std::cout << "MESH CACHE " << load.CachePath << ": loaded " << load.Meshes.size() << " meshes" << std::endl;
+		load.Cache->Close();
+	}
+	else if (load.Cache != nullptr) {
+		// file IO only, the cooked meshes were moved into the cache, so the GL thread does not wait for the write
+		std::shared_ptr<MeshCache> cache = load.Cache;
+		std::string cache_path = load.CachePath;
+		uint64_t source_hash = load.SourceHash;
+		uint64_t options_hash = load.OptionsHash;
+		ThreadPool::GetShared().Submit([cache, cache_path, source_hash, options_hash]() {
+			cache->Write(cache_path, source_hash, options_hash);
+		});
+	}
+	load.Cache.reset();
+
+	_is_resident = true;
+	PrintMemoryReport(load.Path);
+}
+
+void Model::ComputeBounds() {
+	_bounds = Bounds();
+	if (_meshes.empty()) {
+		return;
+	}
+
+	_bounds.Box = _meshes[0].GetBounds().Box;
+	for (const Mesh& mesh : _meshes) {
+		_bounds.Box.Merge(mesh.GetBounds().Box);
+	}
+	_bounds.Sphere.Center = _bounds.Box.GetCenter();
+	_bounds.Sphere.Radius = glm::length(_bounds.Box.Max - _bounds.Box.Min) * 0.5f;
+}
+
+void Model::ReserveDrawList() {
+	// one range per meshlet at most, or one for a mesh without meshlets
+	size_t range_count = 0;
+	for (const Mesh& mesh : _meshes) {
+		range_count += std::max((size_t)1, mesh.GetMeshlets().size());
+	}
+	_draw_list.Reserve(range_count);
+}
+
+void Model::MeasureImportScaling(const std::string& path, const MeshOptions& options) {
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+	if (scene == nullptr) {
+		std::cout << "IMPORT SCALING " << path << ": could not be imported" << std::endl;
+		return;
+	}
+
+	std::vector<const aiMesh*> scene_meshes;
+	CollectMeshes(scene->mRootNode, scene, scene_meshes);
+
+	unsigned int max_threads = ThreadPool::GetShared().GetThreadCount();
+	double single_thread_ms = 0.0;
+	for (unsigned int threads = 1; threads <= max_threads; threads++) {
+		std::vector<std::vector<ConvertedMesh>> converted;
+		double convert_ms = ConvertMeshes(scene_meshes, options, converted, threads);
+		if (threads == 1) {
+			single_thread_ms = convert_ms;
+		}
+		std::cout << "IMPORT SCALING " << path << ": " << threads << " threads " << convert_ms << " ms, "
+			<< single_thread_ms / convert_ms << "x" << std::endl;
+	}
+}
+
+void Model::MeasureTextureCompression(const std::string& path) {
+	if (!TextureCooker::IsEnabled()) {
+		std::cout << "TEXTURE COMPRESSION " << path << ": texture cooking is off" << std::endl;
+		return;
+	}
+
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+	if (scene == nullptr) {
+		std::cout << "TEXTURE COMPRESSION " << path << ": could not be imported" << std::endl;
+		return;
+	}
+
+	std::string directory = path.substr(0, path.find_last_of('/'));
+	std::vector<std::string> texture_paths;
+	for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+		std::vector<Texture> textures = GetMaterialTextures(scene->mMaterials[i], aiTextureType_DIFFUSE, "diffuse");
+		std::vector<Texture> specular_maps = GetMaterialTextures(scene->mMaterials[i], aiTextureType_SPECULAR, "specular");
+		textures.insert(textures.end(), specular_maps.begin(), specular_maps.end());
+		for (const Texture& texture : textures) {
+			std::string texture_path = directory + "/" + texture.Path;
+			if (std::find(texture_paths.begin(), texture_paths.end(), texture_path) == texture_paths.end()) {
+				texture_paths.push_back(texture_path);
+			}
+		}
+	}
+
+	// cooks what is missing and warms the file cache, so both runs below only read and upload
+	for (const std::string& texture_path : texture_paths) {
+		TextureImage image = TextureCooker::Load(texture_path);
+		Texture::Free(image);
+		MappedFile file;
+		file.Open(texture_path);
+	}
+
+	double milliseconds[2];
+	size_t gpu_bytes[2];
+	for (int is_cooked = 0; is_cooked < 2; is_cooked++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		gpu_bytes[is_cooked] = 0;
+		std::vector<unsigned int> ids;
+		for (const std::string& texture_path : texture_paths) {
+			TextureImage image;
+			if (is_cooked) {
+				image = TextureCooker::Load(texture_path);
+			}
+			else {
+				MappedFile file;
+				if (file.Open(texture_path)) {
+					image = Texture::Decode(file.GetData(), file.GetSize(), texture_path);
+				}
+			}
+			gpu_bytes[is_cooked] += image.GetGpuBytes();
+			ids.push_back(Texture::Upload(image));
+		}
+		glFinish();
+		milliseconds[is_cooked] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		glDeleteTextures((GLsizei)ids.size(), ids.data());
+	}
+
+	std::cout << "TEXTURE COMPRESSION " << path << ": " << texture_paths.size() << " textures, uncompressed "
+		<< gpu_bytes[0] / (1024.0 * 1024.0) << " MB in " << milliseconds[0] << " ms, block compressed "
+		<< gpu_bytes[1] / (1024.0 * 1024.0) << " MB in " << milliseconds[1] << " ms, "
+		<< ((double)gpu_bytes[0] - (double)gpu_bytes[1]) / (1024.0 * 1024.0) << " MB and " << milliseconds[0] - milliseconds[1] << " ms saved" << std::endl;
+}
+
+void Model::CollectMeshes(const aiNode* node, const aiScene* scene, std::vector<const aiMesh*>& meshes) {
 	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		_meshes.push_back(ProcessMesh(mesh, scene));
+		meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
 	}
 	// then do the same for each of its children
 	for (unsigned int i = 0; i < node->mNumChildren; i++) {
-		ProcessNode(node->mChildren[i], scene);
+		CollectMeshes(node->mChildren[i], scene, meshes);
 	}
 }
 
-Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene) {
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+double Model::ConvertMeshes(const std::vector<const aiMesh*>& meshes, const MeshOptions& options,
+	std::vector<std::vector<ConvertedMesh>>& converted, unsigned int max_threads) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	converted.clear();
+	converted.resize(meshes.size());
+	ThreadPool::GetShared().ParallelFor(meshes.size(), [&](size_t i) {
+		converted[i] = ConvertMesh(meshes[i], options);
+	}, max_threads);
 
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<Model::ConvertedMesh> Model::ConvertMesh(const aiMesh* mesh, const MeshOptions& options) {
+	// written in place instead of pushed back one by one
+	std::vector<Vertex> vertices(mesh->mNumVertices);
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-		Vertex vertex;
-		glm::vec3 position;
-		position.x = mesh->mVertices[i].x;
-		position.y = mesh->mVertices[i].y;
-		position.z = mesh->mVertices[i].z;
-		vertex.Position = position;
-
-		glm::vec3 normal = glm::vec3(0.0f);
+		Vertex& vertex = vertices[i];
+		vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+
+		vertex.Normal = glm::vec3(0.0f);
 		if (mesh->mNormals != NULL) {
-			normal.x = mesh->mNormals[i].x;
-			normal.y = mesh->mNormals[i].y;
-			normal.z = mesh->mNormals[i].z;
+			vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
 		}
-		vertex.Normal = normal;
 
-		if (mesh->mTextureCoords[0])
-		{
-			glm::vec2 texture_coordinates;
-			texture_coordinates.x = mesh->mTextureCoords[0][i].x;
-			texture_coordinates.y = mesh->mTextureCoords[0][i].y;
-			vertex.TextureCoordinates = texture_coordinates;
-		}
-		else {
-			vertex.TextureCoordinates = glm::vec2(0.0f, 0.0f);
+		vertex.TextureCoordinates = glm::vec2(0.0f, 0.0f);
+		if (mesh->mTextureCoords[0]) {
+			vertex.TextureCoordinates = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
 		}
-
-		vertices.push_back(vertex);
 	}
 
+	std::vector<unsigned int> indices;
+	// polygons are triangulated on import but points and lines come through, and every pass after this reads
+	// the indices in threes, so one of them would shift all the triangles that follow
+	indices.reserve(mesh->mNumFaces * 3);
 	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-		aiFace face = mesh->mFaces[i];
-		for (unsigned int j = 0; j < face.mNumIndices; j++) {
-			indices.push_back(face.mIndices[j]);
+		const aiFace& face = mesh->mFaces[i];
+		if (face.mNumIndices == 3) {
+			indices.insert(indices.end(), face.mIndices, face.mIndices + 3);
 		}
 	}
 
-	if (mesh->mMaterialIndex >= 0) {
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		std::vector<Texture> diffuse_maps = LoadTextures(material, aiTextureType_DIFFUSE, "diffuse");
-		textures.insert(textures.end(), diffuse_maps.begin(), diffuse_maps.end());
-		std::vector<Texture> specular_maps = LoadTextures(material, aiTextureType_SPECULAR, "specular");
-		textures.insert(textures.end(), specular_maps.begin(), specular_maps.end());
-	}
+	// meshes too big for 16 bit indices are split so every part still qualifies
+	std::vector<MeshGeometry> parts = MeshProcessing::SplitByVertexCount(std::move(vertices), std::move(indices), Mesh::MAX_SHORT_INDEX_VERTICES);
+	std::vector<ConvertedMesh> converted(parts.size());
+	for (size_t i = 0; i < parts.size(); i++) {
+		if (options.Optimize) {
+			MeshProcessing::Optimize(parts[i], mesh->mName.C_Str());
+		}
 
-	return Mesh(vertices, indices, textures);
+		converted[i].Cooked = Mesh::Cook(parts[i].Vertices, parts[i].Indices, options);
+		if (options.Residency != GeometryResidency::DropAfterUpload) {
+			converted[i].Vertices = std::move(parts[i].Vertices);
+			converted[i].Indices = std::move(parts[i].Indices);
+		}
+	}
+	return converted;
 }
 
-std::vector<Texture> Model::LoadTextures(aiMaterial* material, aiTextureType texture_type, std::string texture_type_name) {
+std::vector<Texture> Model::GetMaterialTextures(const aiMaterial* material, aiTextureType texture_type, std::string texture_type_name) {
 	std::vector<Texture> textures;
 	for (unsigned int i = 0; i < material->GetTextureCount(texture_type); i++) {
 		aiString str;
 		material->GetTexture(texture_type, i, &str);
-		bool skip = false;
-		for (unsigned int j = 0; j < _loaded_textures.size(); j++) {
-			if (std::strcmp(_loaded_textures[j].Path.data(), str.C_Str()) == 0) {
-				textures.push_back(_loaded_textures[j]);
-				skip = true;
-				break;
+		textures.push_back(Texture(0, texture_type_name, str.C_Str()));
+	}
+	return textures;
+}
+
+void Model::DecodeTextures(PendingLoad& load, const std::vector<std::vector<Texture>>& mesh_textures) {
+	std::string directory = load.Path.substr(0, load.Path.find_last_of('/'));
+	std::unordered_map<std::string, size_t> image_indices;
+	for (const std::vector<Texture>& textures : mesh_textures) {
+		for (const Texture& texture : textures) {
+			if (!image_indices.emplace(texture.Path, load.ImagePaths.size()).second) {
+				continue;
 			}
+
+			std::string canonical_path = TextureCache::Canonicalize(directory + "/" + texture.Path);
+			uint64_t content_hash = 0;
+			bool is_decoding = false;
+			if (!TextureCache::GetShared().Contains(canonical_path)) {
+				content_hash = TextureCache::HashContent(canonical_path);
+				if (!TextureCache::GetShared().ContainsContent(content_hash)) {
+					load.Decodes.Add(load.ImagePaths.size(), canonical_path);
+					is_decoding = true;
+				}
+			}
+
+			load.ImagePaths.push_back(texture.Path);
+			load.CanonicalImagePaths.push_back(canonical_path);
+			load.ImageHashes.push_back(content_hash);
+			load.IsDecoding.push_back(is_decoding);
 		}
+	}
+}
 
-		if (!skip) {
-			Texture texture;
-			texture.Id = Texture::Load(_path + "/" + std::string(str.C_Str()));
-			texture.Type = texture_type_name;
-			texture.Path = str.C_Str();
-			textures.push_back(texture);
-			_loaded_textures.push_back(texture);
+void Model::AcquireTexture(PendingLoad& load, size_t index, TextureImage& image) {
+	UploadRing* staging = load.Options.Staging;
+	TextureReference reference = TextureCache::GetShared().Acquire(load.CanonicalImagePaths[index], load.ImageHashes[index], image, staging);
+	_texture_ids[load.ImagePaths[index]] = reference.GetId();
+	_texture_references.push_back(std::move(reference));
+
+	// a hit already freed the image, a miss reads from it until the ring has issued the copies
+	if (staging != nullptr && image.IsValid()) {
+		load.StagedImages.push_back(std::move(image));
+		image = TextureImage();
+		load.LastTicket = staging->GetLastTicket();
+	}
+}
+
+std::vector<Texture> Model::ResolveTextures(const std::vector<Texture>& textures) const {
+	std::vector<Texture> resolved = textures;
+	for (Texture& texture : resolved) {
+		std::unordered_map<std::string, unsigned int>::const_iterator it = _texture_ids.find(texture.Path);
+		if (it != _texture_ids.end()) {
+			texture.Id = it->second;
 		}
 	}
-	return textures;
+	return resolved;
 }
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <chrono>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <assimp/Importer.hpp>
@@ -8,23 +11,93 @@
 #include <assimp/postprocess.h>
 
 #include "Texture.h"
+#include "TextureCache.h"
 #include "Shader.h"
 #include "Mesh.h"
+#include "Frustum.h"
+#include "MeshCache.h"
+#include "RenderQueue.h"
 
 class Model {
 public:
 	Model();
 	Model(std::vector<Mesh> meshes);
-	Model(std::string path, bool load_immediately = true);
-	void Draw(Shader shader);
+	Model(std::string path, bool load_immediately = true, MeshOptions options = MeshOptions());
+	// loads the path given to the constructor, for a model constructed with load_immediately = false
+	void Load();
+	// false while the model is still loading, it draws and culls nothing until then
+	bool IsResident() const;
+	const std::string& GetSourcePath() const;
+	const MeshOptions& GetOptions() const;
+
+	// CPU side of a load: imported or mapped meshes and decoded textures, defined in Model.cpp
+	struct PendingLoad;
+	// everything of a load that does not need GL, runs on any thread
+	static std::shared_ptr<PendingLoad> Import(const std::string& path, const MeshOptions& options);
+	// uploads the textures and meshes of an import until the deadline has passed, at least one per call,
+	// true once the model is resident
+	bool Upload(PendingLoad& load, std::chrono::steady_clock::time_point deadline);
+
+	void Draw(const Shader& shader) const;
+	// one instanced draw per mesh for all transforms in the buffer, without culling
+	void DrawInstanced(const Shader& shader, const InstanceBuffer& instances) const;
+	// queues the meshes (and meshlets) that survive culling against the view, drawn on the queue's next flush
+	void Submit(RenderQueue& queue, const Shader& shader, const glm::mat4& model_matrix, const DrawView& view, CullingStats& stats) const;
+	// the culling of Submit without queueing anything, for benchmarks
+	void Cull(const glm::mat4& model_matrix, const DrawView& view, CullingStats& stats) const;
+
+	const Bounds& GetBounds() const;
+	unsigned int GetTriangleCount() const;
+	unsigned int GetMeshletCount() const;
+
+	size_t GetCpuBytes() const;
+	size_t GetGpuBytes() const;
+	size_t GetIndexBytesSaved() const;
+	void PrintMemoryReport(const std::string& name) const;
+
+	// imports a model once, then times the mesh conversion of Load on 1 to N threads and prints the speedup
+	static void MeasureImportScaling(const std::string& path, const MeshOptions& options);
+	// loads the textures of a model plain and block compressed, cooking them first if needed, and prints VRAM and
+	// load time of both
+	static void MeasureTextureCompression(const std::string& path);
 
 private:
+	// one part of an imported mesh after conversion, CPU work only so it can run on any thread
+	struct ConvertedMesh {
+		// empty when the residency would drop them after upload anyway
+		std::vector<Vertex> Vertices;
+		std::vector<unsigned int> Indices;
+		CookedMesh Cooked;
+	};
+
 	std::vector<Mesh> _meshes;
+	std::string _source_path;
 	std::string _path;
-	std::vector<Texture> _loaded_textures;
+	bool _is_resident;
+	MeshOptions _options;
+	Bounds _bounds;
+	// uploaded texture per path relative to the model, the references keep them in the texture cache
+	std::unordered_map<std::string, unsigned int> _texture_ids;
+	std::vector<TextureReference> _texture_references;
+	// index ranges of the culling benchmark, reserved at load so it does not allocate
+	mutable DrawList _draw_list;
 
-	void Load(std::string path);
-	void ProcessNode(aiNode* node, const aiScene* scene);
-	Mesh ProcessMesh(aiMesh* mesh, const aiScene* scene);
-	std::vector<Texture> LoadTextures(aiMaterial* material, aiTextureType texture_type, std::string texture_type_name);
+	void ComputeBounds();
+	void ReserveDrawList();
+	// the scene's meshes in node order
+	static void CollectMeshes(const aiNode* node, const aiScene* scene, std::vector<const aiMesh*>& meshes);
+	// vertex conversion, index flattening, splitting, optimization and cooking of every mesh on the shared thread pool,
+	// returns the time it took in milliseconds
+	static double ConvertMeshes(const std::vector<const aiMesh*>& meshes, const MeshOptions& options,
+		std::vector<std::vector<ConvertedMesh>>& converted, unsigned int max_threads);
+	static std::vector<ConvertedMesh> ConvertMesh(const aiMesh* mesh, const MeshOptions& options);
+	// type and path of a material's textures, Id is left 0 until they are uploaded
+	static std::vector<Texture> GetMaterialTextures(const aiMaterial* material, aiTextureType texture_type, std::string texture_type_name);
+	// starts decoding every texture the meshes use once on the thread pool, skipping those the texture cache already has
+	static void DecodeTextures(PendingLoad& load, const std::vector<std::vector<Texture>>& mesh_textures);
+	void AcquireTexture(PendingLoad& load, size_t index, TextureImage& image);
+	// the uploaded textures for a mesh's type and path list
+	std::vector<Texture> ResolveTextures(const std::vector<Texture>& textures) const;
+	// bounds, draw list and cache write once every mesh is uploaded
+	void FinishLoad(PendingLoad& load);
 };
\ No newline at end of file
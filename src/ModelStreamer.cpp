@@ -0,0 +1,62 @@
+#include "ModelStreamer.h"
+
+#include <iostream>
+
+#include "ThreadPool.h"
+
+ModelStreamer::ModelStreamer(double upload_budget_ms) : _upload_budget_ms(upload_budget_ms) {
+}
+
+void ModelStreamer::Load(Model& model) {
+	std::shared_ptr<Request> request = std::make_shared<Request>();
+	request->Target = &model;
+	request->Path = model.GetSourcePath();
+	request->Options = model.GetOptions();
+	request->IsImported = false;
+	request->Start = std::chrono::steady_clock::now();
+	request->Frames = 0;
+	_requests.push_back(request);
+
+	ThreadPool::GetShared().Submit([request]() {
+		request->Load = Model::Import(request->Path, request->Options);
+		request->IsImported = true;
+	});
+}
+
+void ModelStreamer::Update() {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point deadline = now +
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(_upload_budget_ms));
+
+	// in request order, a later model only gets the budget left over by earlier ones
+	for (size_t i = 0; i < _requests.size();) {
+		Request& request = *_requests[i];
+		request.Frames++;
+		if (!request.IsImported || now >= deadline) {
+			i++;
+			continue;
+		}
+
+		if (request.Target->Upload(*request.Load, deadline)) {
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - request.Start).count();
+			std::cout << "STREAM " << request.Path << ": resident after " << milliseconds << " ms, " << request.Frames << " frames" << std::endl;
+			_requests.erase(_requests.begin() + i);
+		}
+		else {
+			i++;
+		}
+		now = std::chrono::steady_clock::now();
+	}
+}
+
+void ModelStreamer::SetUploadBudget(double milliseconds) {
+	_upload_budget_ms = milliseconds;
+}
+
+double ModelStreamer::GetUploadBudget() const {
+	return _upload_budget_ms;
+}
+
+size_t ModelStreamer::GetPendingCount() const {
+	return _requests.size();
+}
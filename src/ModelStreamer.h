@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Model.h"
+
+// Loads models while frames keep rendering. Import (or mapping the mesh cache) and texture decoding run on the
+// shared thread pool, the GL uploads are spread over the frames by Update under a time budget. A streamed model
+// is its own handle: it draws and culls nothing until IsResident, so a scene shows up model by model.
+class ModelStreamer {
+public:
+	explicit ModelStreamer(double upload_budget_ms = 2.0);
+	ModelStreamer(const ModelStreamer&) = delete;
+	ModelStreamer& operator=(const ModelStreamer&) = delete;
+
+	// starts loading the path the model was constructed with and returns right away,
+	// the model has to stay where it is until it is resident
+	void Load(Model& model);
+	// on the GL thread once per frame, uploads finished imports until the budget is spent
+	void Update();
+
+	void SetUploadBudget(double milliseconds);
+	double GetUploadBudget() const;
+	// models not resident yet
+	size_t GetPendingCount() const;
+
+private:
+	struct Request {
+		Model* Target;
+		std::string Path;
+		MeshOptions Options;
+		// written by the import job, only read after IsImported is set
+		std::shared_ptr<Model::PendingLoad> Load;
+		std::atomic<bool> IsImported;
+		std::chrono::steady_clock::time_point Start;
+		unsigned int Frames;
+	};
+
+	// shared with the import jobs, a job outliving the streamer never touches its model
+	std::vector<std::shared_ptr<Request>> _requests;
+	double _upload_budget_ms;
+};
@@ -0,0 +1,192 @@
+#include "ProgramCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "MappedFile.h"
+
+// glad is generated for GL 3.3, program binaries are GL 4.1
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+static const char MAGIC[8] = { 'L', 'O', 'G', 'L', 'P', 'R', 'G', '\0' };
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei buffer_size, GLsizei* length, GLenum* binary_format, void* binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binary_format, const void* binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum name, GLint value);
+
+struct ProgramBinaryProcs {
+	GetProgramBinaryProc GetProgramBinary = nullptr;
+	ProgramBinaryProc ProgramBinary = nullptr;
+	ProgramParameteriProc ProgramParameteri = nullptr;
+	bool IsSupported = false;
+};
+
+// loaded once, the context is the same for every program
+static const ProgramBinaryProcs& GetProcs() {
+	static ProgramBinaryProcs procs = []() {
+		ProgramBinaryProcs loaded;
+		GLint major_version = 0;
+		GLint minor_version = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major_version);
+		glGetIntegerv(GL_MINOR_VERSION, &minor_version);
+		bool has_binaries = major_version > 4 || (major_version == 4 && minor_version >= 1) || glfwExtensionSupported("GL_ARB_get_program_binary");
+		if (!has_binaries) {
+			return loaded;
+		}
+
+		loaded.GetProgramBinary = (GetProgramBinaryProc)glfwGetProcAddress("glGetProgramBinary");
+		loaded.ProgramBinary = (ProgramBinaryProc)glfwGetProcAddress("glProgramBinary");
+		loaded.ProgramParameteri = (ProgramParameteriProc)glfwGetProcAddress("glProgramParameteri");
+
+		// some drivers expose the entry points but no format to save in
+		GLint format_count = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+		loaded.IsSupported = loaded.GetProgramBinary != nullptr && loaded.ProgramBinary != nullptr && loaded.ProgramParameteri != nullptr &&
+			format_count > 0;
+		return loaded;
+	}();
+	return procs;
+}
+
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * FNV_PRIME;
+	}
+	return hash;
+}
+
+static uint64_t HashString(uint64_t hash, const char* text) {
+	if (text == nullptr) {
+		return hash;
+	}
+	// the terminator too, so "ab" + "c" and "a" + "bc" differ
+	return HashBytes(hash, text, std::strlen(text) + 1);
+}
+
+bool ProgramCache::IsSupported() {
+	return GetProcs().IsSupported;
+}
+
+bool ProgramCache::Load(unsigned int program, const std::string& path, uint64_t source_hash) {
+	if (!IsSupported()) {
+		return false;
+	}
+
+	MappedFile file;
+	if (!file.Open(path)) {
+		return false;
+	}
+
+	FileHeader header;
+	if (file.GetSize() < sizeof(header)) {
+		return false;
+	}
+	std::memcpy(&header, file.GetData(), sizeof(header));
+	if (std::memcmp(header.Magic, MAGIC, sizeof(MAGIC)) != 0 || header.Version != VERSION || header.SourceHash != source_hash ||
+		header.DriverHash != GetDriverHash() || file.GetSize() - sizeof(header) < header.BinarySize) {
+		std::cout << "PROGRAM CACHE " << path << ": stale, compiling again" << std::endl;
+		return false;
+	}
+
+	GetProcs().ProgramBinary(program, header.BinaryFormat, file.GetData() + sizeof(header), (GLsizei)header.BinarySize);
+
+	// the driver may still refuse a binary it wrote, e.g. after an update that kept the version string
+	int is_linked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+	if (!is_linked) {
+		std::cout << "PROGRAM CACHE " << path << ": rejected by the driver, compiling again" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void ProgramCache::PrepareLink(unsigned int program) {
+	if (IsSupported()) {
+		GetProcs().ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+}
+
+bool ProgramCache::Save(unsigned int program, const std::string& path, uint64_t source_hash) {
+	if (!IsSupported()) {
+		return false;
+	}
+
+	GLint binary_size = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_size);
+	if (binary_size <= 0) {
+		return false;
+	}
+
+	FileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.Magic, MAGIC, sizeof(MAGIC));
+	header.Version = VERSION;
+	header.SourceHash = source_hash;
+	header.DriverHash = GetDriverHash();
+
+	std::vector<unsigned char> file(sizeof(header) + binary_size);
+	GLsizei written = 0;
+	GLenum binary_format = 0;
+	GetProcs().GetProgramBinary(program, binary_size, &written, &binary_format, file.data() + sizeof(header));
+	if (written <= 0) {
+		return false;
+	}
+	header.BinaryFormat = binary_format;
+	header.BinarySize = (uint64_t)written;
+	std::memcpy(file.data(), &header, sizeof(header));
+
+	// written next to the old file and moved over it, so a crash never leaves a half written binary behind
+	std::string temporary_path = path + ".tmp";
+	{
+		std::ofstream stream(temporary_path, std::ios::binary | std::ios::trunc);
+		if (!stream.write((const char*)file.data(), sizeof(header) + written)) {
+			std::cout << "PROGRAM CACHE " << path << ": could not be written" << std::endl;
+			return false;
+		}
+	}
+	std::remove(path.c_str());
+	if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+		std::remove(temporary_path.c_str());
+		std::cout << "PROGRAM CACHE " << path << ": could not be written" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+std::string ProgramCache::GetCachePath(const std::string& vert_path, const std::string& frag_path, const std::vector<std::string>& defines) {
+	// vertex shaders are paired with several fragment shaders and the other way round, so both names go in
+	size_t separator = frag_path.find_last_of("/\\");
+	std::string path = vert_path + "." + (separator == std::string::npos ? frag_path : frag_path.substr(separator + 1));
+	for (const std::string& define : defines) {
+		path += "." + define;
+	}
+	return path + ".loglprog";
+}
+
+uint64_t ProgramCache::HashSources(const std::string& vert_code, const std::string& frag_code) {
+	uint64_t hash = HashString(FNV_OFFSET_BASIS, vert_code.c_str());
+	return HashString(hash, frag_code.c_str());
+}
+
+uint64_t ProgramCache::GetDriverHash() {
+	uint64_t hash = HashString(FNV_OFFSET_BASIS, (const char*)glGetString(GL_VENDOR));
+	hash = HashString(hash, (const char*)glGetString(GL_RENDERER));
+	return HashString(hash, (const char*)glGetString(GL_VERSION));
+}
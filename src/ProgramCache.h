@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Linked shader programs cached next to their vertex shader, e.g. v_g_pass.glsl.f_g_pass.glsl.loglprog, so later
+// launches hand the driver a binary instead of compiling and linking GLSL. Binaries only load on the driver that
+// wrote them, so a file is used only when its version, the hash of both sources and the hash of the GL vendor,
+// renderer and version strings all match, otherwise the program is built from source and the file rewritten.
+// Without GL 4.1 or ARB_get_program_binary every program is built from source.
+//
+// Layout: FileHeader, then the binary as glGetProgramBinary returned it.
+class ProgramCache {
+public:
+	static const uint32_t VERSION = 1;
+
+	// needs the context current, the entry points are loaded on the first call
+	static bool IsSupported();
+
+	// links program from its cached binary, false when the file is missing or stale or the driver rejects it
+	static bool Load(unsigned int program, const std::string& path, uint64_t source_hash);
+	// before glLinkProgram, tells the driver the binary will be asked for
+	static void PrepareLink(unsigned int program);
+	// writes the binary of a linked program
+	static bool Save(unsigned int program, const std::string& path, uint64_t source_hash);
+
+	// defines name the variant, so each permutation of a pair keeps its own file
+	static std::string GetCachePath(const std::string& vert_path, const std::string& frag_path, const std::vector<std::string>& defines);
+	static uint64_t HashSources(const std::string& vert_code, const std::string& frag_code);
+
+private:
+	struct FileHeader {
+		char Magic[8];
+		uint32_t Version;
+		uint32_t BinaryFormat;
+		uint64_t SourceHash;
+		uint64_t DriverHash;
+		uint64_t BinarySize;
+	};
+
+	// GL_VENDOR, GL_RENDERER and GL_VERSION, a driver update invalidates every binary
+	static uint64_t GetDriverHash();
+};
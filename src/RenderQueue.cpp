@@ -0,0 +1,204 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+RenderQueue::RenderQueue() : _is_sorting_enabled(true), _program(NO_STATE), _vertex_array(NO_STATE), _material(NO_STATE),
+	_transform(NO_STATE), _quantization(nullptr), _is_octahedral(false) {
+	for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+		_textures[i] = NO_STATE;
+	}
+}
+
+unsigned int RenderQueue::AddTransform(const glm::mat4& model_matrix) {
+	_transforms.push_back(model_matrix);
+	return (unsigned int)_transforms.size() - 1;
+}
+
+void RenderQueue::Add(const Shader& shader, const Mesh& mesh, unsigned int transform, size_t first_range, float view_distance) {
+	RenderItem item;
+	item.ItemShader = &shader;
+	item.ItemMesh = &mesh;
+	item.Transform = transform;
+	item.FirstRange = first_range;
+	item.RangeCount = _ranges.Size() - first_range;
+
+	SortEntry entry;
+	entry.Key = MakeKey(shader.GetId(), mesh.GetMaterialId(), mesh.GetVertexArray(), view_distance);
+	entry.Item = (unsigned int)_items.size();
+
+	_items.push_back(item);
+	_entries.push_back(entry);
+}
+
+DrawList& RenderQueue::GetRanges() {
+	return _ranges;
+}
+
+void RenderQueue::Flush(RenderStats& stats, const glm::mat4& view_projection) {
+	stats.Items += (unsigned int)_items.size();
+
+	if (!_items.empty()) {
+		_transform_buffer.Upload(_transforms, view_projection);
+	}
+
+	if (_is_sorting_enabled) {
+		RadixSort(_entries, _sort_scratch);
+	}
+
+	_program = NO_STATE;
+	_vertex_array = NO_STATE;
+	_material = NO_STATE;
+	_transform = NO_STATE;
+	_quantization = nullptr;
+	for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+		_textures[i] = NO_STATE;
+	}
+
+	size_t i = 0;
+	while (i < _entries.size()) {
+		const RenderItem& first = _items[_entries[i].Item];
+		Bind(first, stats);
+
+		// everything up to the next state change goes out in one draw
+		_batch.Clear();
+		size_t j = i;
+		for (; j < _entries.size(); j++) {
+			const RenderItem& item = _items[_entries[j].Item];
+			if (!CanMerge(first, item)) {
+				break;
+			}
+			for (size_t range = item.FirstRange; range < item.FirstRange + item.RangeCount; range++) {
+				_batch.Counts.push_back(_ranges.Counts[range]);
+				_batch.Offsets.push_back(_ranges.Offsets[range]);
+				_batch.BaseVertices.push_back(_ranges.BaseVertices[range]);
+			}
+		}
+
+		first.ItemMesh->Submit(_batch);
+		stats.DrawCalls++;
+		i = j;
+	}
+
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+
+	// clearing keeps the capacity, so a steady scene stops allocating after the first frames
+	_items.clear();
+	_transforms.clear();
+	_ranges.Clear();
+	_entries.clear();
+}
+
+void RenderQueue::SetSortingEnabled(bool is_enabled) {
+	_is_sorting_enabled = is_enabled;
+}
+
+void RenderQueue::RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch) {
+	if (entries.size() < 2) {
+		return;
+	}
+
+	scratch.resize(entries.size());
+	for (unsigned int shift = 0; shift < 64; shift += 8) {
+		size_t counts[256] = {};
+		for (const SortEntry& entry : entries) {
+			counts[(entry.Key >> shift) & 0xFF]++;
+		}
+
+		if (counts[(entries[0].Key >> shift) & 0xFF] == entries.size()) {
+			continue;
+		}
+
+		size_t offset = 0;
+		for (unsigned int digit = 0; digit < 256; digit++) {
+			size_t count = counts[digit];
+			counts[digit] = offset;
+			offset += count;
+		}
+
+		for (const SortEntry& entry : entries) {
+			scratch[counts[(entry.Key >> shift) & 0xFF]++] = entry;
+		}
+		entries.swap(scratch);
+	}
+}
+
+uint64_t RenderQueue::MakeKey(unsigned int program, unsigned int material, unsigned int vertex_array, float view_distance) {
+	// the bits of a non negative float sort like the float itself, the top 22 below the sign bit are kept
+	float distance = std::max(view_distance, 0.0f);
+	uint32_t distance_bits = 0;
+	std::memcpy(&distance_bits, &distance, sizeof(distance_bits));
+
+	return ((uint64_t)(program & 0x3FF) << 54) |
+		((uint64_t)(material & 0xFFFFF) << 34) |
+		((uint64_t)(vertex_array & 0xFFF) << 22) |
+		(uint64_t)((distance_bits >> 9) & 0x3FFFFF);
+}
+
+bool RenderQueue::CanMerge(const RenderItem& a, const RenderItem& b) const {
+	const Mesh& mesh_a = *a.ItemMesh;
+	const Mesh& mesh_b = *b.ItemMesh;
+	return a.ItemShader->GetId() == b.ItemShader->GetId() &&
+		a.Transform == b.Transform &&
+		mesh_a.GetMaterialId() == mesh_b.GetMaterialId() &&
+		mesh_a.GetVertexArray() == mesh_b.GetVertexArray() &&
+		mesh_a.GetIndexType() == mesh_b.GetIndexType() &&
+		mesh_a.GetQuantization().PositionOffset == mesh_b.GetQuantization().PositionOffset &&
+		mesh_a.GetQuantization().PositionScale == mesh_b.GetQuantization().PositionScale &&
+		mesh_a.IsOctahedral() == mesh_b.IsOctahedral();
+}
+
+void RenderQueue::Bind(const RenderItem& item, RenderStats& stats) {
+	const Shader& shader = *item.ItemShader;
+	const Mesh& mesh = *item.ItemMesh;
+
+	// uniforms belong to the program, a new program needs all of them again
+	if (shader.GetId() != _program) {
+		glUseProgram(shader.GetId());
+		_program = shader.GetId();
+		_material = NO_STATE;
+		_quantization = nullptr;
+		stats.ProgramBinds++;
+	}
+
+	if (item.Transform != _transform) {
+		// a buffer binding, not program state, so it survives program changes
+		_transform_buffer.Bind(item.Transform);
+		_transform = item.Transform;
+	}
+
+	const MeshUniforms& uniforms = shader.GetMeshUniforms();
+	if (mesh.GetMaterialId() != _material) {
+		const std::vector<int>& sampler_slots = mesh.GetSamplerSlots();
+		unsigned int texture_count = mesh.Textures.size() < MAX_TEXTURE_UNITS ? (unsigned int)mesh.Textures.size() : MAX_TEXTURE_UNITS;
+		for (unsigned int i = 0; i < texture_count; i++) {
+			if (_textures[i] != mesh.Textures[i].Id) {
+				glActiveTexture(GL_TEXTURE0 + i);
+				glBindTexture(GL_TEXTURE_2D, mesh.Textures[i].Id);
+				_textures[i] = mesh.Textures[i].Id;
+				stats.TextureBinds++;
+			}
+			if (sampler_slots[i] >= 0) {
+				shader.Set(uniforms.Samplers[sampler_slots[i]], (int)i);
+			}
+		}
+		_material = mesh.GetMaterialId();
+	}
+
+	const VertexQuantization& quantization = mesh.GetQuantization();
+	if (_quantization == nullptr || _quantization->PositionOffset != quantization.PositionOffset ||
+		_quantization->PositionScale != quantization.PositionScale || _is_octahedral != mesh.IsOctahedral()) {
+		shader.Set(uniforms.PositionOffset, quantization.PositionOffset);
+		shader.Set(uniforms.PositionScale, quantization.PositionScale);
+		shader.Set(uniforms.OctahedralNormals, mesh.IsOctahedral());
+		_quantization = &quantization;
+		_is_octahedral = mesh.IsOctahedral();
+	}
+
+	if (mesh.GetVertexArray() != _vertex_array) {
+		glBindVertexArray(mesh.GetVertexArray());
+		_vertex_array = mesh.GetVertexArray();
+		stats.VertexArrayBinds++;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GeometryArena.h"
+#include "Mesh.h"
+#include "Shader.h"
+#include "TransformBuffer.h"
+
+// GL state changes and draws issued by one flush of a render queue
+struct RenderStats {
+	unsigned int Items = 0;
+	unsigned int ProgramBinds = 0;
+	unsigned int TextureBinds = 0;
+	unsigned int VertexArrayBinds = 0;
+	unsigned int DrawCalls = 0;
+};
+
+// Collects the visible meshes of a pass, sorts them by a 64 bit key and draws them while skipping program,
+// texture, vertex array and uniform updates that would not change anything. Consecutive items with the
+// same state are merged into one multi draw.
+//
+// Key layout from the most significant bit: program (10 bits), material (20 bits), vertex array (12 bits),
+// view distance (22 bits, front to back). GL names and material ids wider than their field are masked,
+// which only costs grouping, never correctness, as binds compare the real values.
+class RenderQueue {
+public:
+	struct SortEntry {
+		uint64_t Key;
+		unsigned int Item;
+	};
+
+	RenderQueue();
+
+	// the model matrix shared by the items added after it
+	unsigned int AddTransform(const glm::mat4& model_matrix);
+	// the ranges appended to GetRanges() since first_range become one item
+	void Add(const Shader& shader, const Mesh& mesh, unsigned int transform, size_t first_range, float view_distance);
+	DrawList& GetRanges();
+
+	// sorts and draws everything added since the last flush, then empties the queue
+	// the object transforms of the whole pass are computed and uploaded once up front
+	void Flush(RenderStats& stats, const glm::mat4& view_projection);
+
+	// with sorting off items are drawn in submission order, to compare state changes
+	void SetSortingEnabled(bool is_enabled);
+
+	// least significant digit radix sort on Key, 8 bits per pass, passes where every key shares the digit are skipped
+	static void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch);
+
+private:
+	struct RenderItem {
+		const Shader* ItemShader;
+		const Mesh* ItemMesh;
+		unsigned int Transform;
+		size_t FirstRange;
+		size_t RangeCount;
+	};
+
+	static const unsigned int MAX_TEXTURE_UNITS = 16;
+	static const unsigned int NO_STATE = 0xFFFFFFFF;
+
+	std::vector<RenderItem> _items;
+	std::vector<glm::mat4> _transforms;
+	TransformBuffer _transform_buffer;
+	DrawList _ranges;
+	std::vector<SortEntry> _entries;
+	std::vector<SortEntry> _sort_scratch;
+	// ranges of the merged items being drawn
+	DrawList _batch;
+	bool _is_sorting_enabled;
+
+	// what is bound right now, reset on every flush since other code binds in between
+	unsigned int _program;
+	unsigned int _vertex_array;
+	unsigned int _material;
+	unsigned int _transform;
+	// points at the decoding of the last bound mesh, null when nothing is set
+	const VertexQuantization* _quantization;
+	bool _is_octahedral;
+	unsigned int _textures[MAX_TEXTURE_UNITS];
+
+	static uint64_t MakeKey(unsigned int program, unsigned int material, unsigned int vertex_array, float view_distance);
+	bool CanMerge(const RenderItem& a, const RenderItem& b) const;
+	void Bind(const RenderItem& item, RenderStats& stats);
+};
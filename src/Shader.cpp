@@ -1,75 +1,223 @@
 #include "Shader.h"
 
-Shader::Shader(const char* vert_path, const char* frag_path) {
-	std::string vert_code;
-	std::ifstream vert_fstream(vert_path);
+#include <chrono>
+#include <cstring>
+
+#include "FrameUniformBuffer.h"
+#include "ProgramCache.h"
+#include "ShaderBatch.h"
+#include "TransformBuffer.h"
+
+UniformStats Shader::_uniform_stats;
+ShaderLoadStats Shader::_load_stats;
 
-	if (vert_fstream.is_open()) {
-		std::stringstream vert_sstream;
-		vert_sstream << vert_fstream.rdbuf();
-		vert_fstream.close();
-		vert_code = vert_sstream.str();
+// FNV-1a, names are short and only hashed on lookups by name
+static uint32_t HashUniformName(const char* name) {
+	uint32_t hash = 2166136261u;
+	for (const char* c = name; *c != '\0'; c++) {
+		hash = (hash ^ (unsigned char)*c) * 16777619u;
 	}
-	else {
-		std::cerr << "SHADER FILE COULD NOT BE OPENED" << std::endl;
+	return hash;
+}
+
+int MeshUniforms::GetSamplerSlot(const std::string& type, unsigned int index) {
+	if (type == "splat") {
+		return index == 0 ? SAMPLERS_PER_TYPE * 2 : -1;
+	}
+	if (index >= SAMPLERS_PER_TYPE) {
+		return -1;
+	}
+	if (type == "diffuse") {
+		return (int)index;
+	}
+	if (type == "specular") {
+		return (int)(SAMPLERS_PER_TYPE + index);
+	}
+	return -1;
+}
+
+// the whole file in one read
+static bool ReadShaderFile(const char* path, std::string& code) {
+	std::ifstream stream(path, std::ios::binary | std::ios::ate);
+	if (!stream.is_open()) {
+		return false;
+	}
+	std::streamoff size = stream.tellg();
+	code.resize((size_t)size);
+	stream.seekg(0);
+	return size == 0 || (bool)stream.read(&code[0], size);
+}
+
+// the defines go right after #version, which has to stay the first line, and #line keeps error lines as in the file
+static void InsertDefines(std::string& code, const std::vector<std::string>& defines) {
+	if (defines.empty()) {
 		return;
 	}
 
+	size_t insert_at = 0;
+	int next_line = 1;
+	if (code.compare(0, 8, "#version") == 0) {
+		size_t line_end = code.find('\n');
+		insert_at = line_end == std::string::npos ? code.size() : line_end + 1;
+		next_line = 2;
+	}
+
+	std::string lines = insert_at == code.size() && insert_at > 0 ? "\n" : "";
+	for (const std::string& define : defines) {
+		lines += "#define " + define + "\n";
+	}
+	lines += "#line " + std::to_string(next_line) + "\n";
+	code.insert(insert_at, lines);
+}
+
+Shader::Shader(const char* vert_path, const char* frag_path) : Shader(vert_path, frag_path, std::vector<std::string>(), nullptr) {
+}
+
+Shader::Shader(const char* vert_path, const char* frag_path, ShaderBatch& batch) : Shader(vert_path, frag_path, std::vector<std::string>(), &batch) {
+}
+
+Shader::Shader(const char* vert_path, const char* frag_path, const std::vector<std::string>& defines, ShaderBatch* batch)
+	: _program_id(0), _is_from_cache(false), _is_ready(false), _batch(nullptr) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::string vert_code;
 	std::string frag_code;
-	std::ifstream frag_fstream(frag_path);
+	if (!ReadShaderFile(vert_path, vert_code) || !ReadShaderFile(frag_path, frag_code)) {
+		std::cerr << "SHADER FILE COULD NOT BE OPENED" << std::endl;
+		_is_ready = true;
+		return;
+	}
+	InsertDefines(vert_code, defines);
+	InsertDefines(frag_code, defines);
 
-	if (frag_fstream.is_open()) {
-		std::stringstream frag_sstream;
-		frag_sstream << frag_fstream.rdbuf();
-		frag_fstream.close();
-		frag_code = frag_sstream.str();
+	// the binary of an earlier launch skips compiling and linking
+	std::string cache_path = ProgramCache::GetCachePath(vert_path, frag_path, defines);
+	uint64_t source_hash = ProgramCache::HashSources(vert_code, frag_code);
+	_program_id = glCreateProgram();
+	_is_from_cache = ProgramCache::Load(_program_id, cache_path, source_hash);
+	if (!_is_from_cache) {
+		_pending.reset(new PendingBuild());
+		_pending->CachePath = cache_path;
+		_pending->SourceHash = source_hash;
+		Build(vert_code, frag_code);
+	}
+
+	_load_stats.Programs++;
+	if (_is_from_cache) {
+		_load_stats.CachedPrograms++;
+	}
+	_load_stats.Milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// a cached binary is linked already, there is nothing to wait for
+	if (batch != nullptr && batch->IsEnabled() && _pending) {
+		_batch = batch;
+		_batch->Add(this);
 	}
 	else {
-		std::cerr << "SHADER FILE COULD NOT BE OPENED" << std::endl;
+		Finish();
+	}
+}
+
+Shader::~Shader() {
+	if (_batch != nullptr) {
+		_batch->Remove(this);
+	}
+}
+
+void Shader::Finish() {
+	if (_is_ready) {
 		return;
 	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
+	// the first status query is where the driver's compile and link are waited for
+	if (_pending) {
+		if (CheckBuild()) {
+			ProgramCache::Save(_program_id, _pending->CachePath, _pending->SourceHash);
+		}
+		_pending.reset();
+	}
+
+	// GLSL 330 has no layout binding, so the shared blocks are pointed at their binding points here
+	const struct {
+		const char* Name;
+		GLuint Binding;
+	} blocks[] = {
+		{ "ObjectTransform", TransformBuffer::BINDING },
+		{ "FrameData", FrameUniformBuffer::FRAME_BINDING },
+		{ "LightData", FrameUniformBuffer::LIGHT_BINDING },
+	};
+	for (const auto& block : blocks) {
+		unsigned int block_index = glGetUniformBlockIndex(_program_id, block.Name);
+		if (block_index != GL_INVALID_INDEX) {
+			glUniformBlockBinding(_program_id, block_index, block.Binding);
+		}
+	}
+
+	LoadUniforms();
+	_is_ready = true;
+	// after _is_ready, lookups would finish the program again otherwise
+	LoadMeshUniforms();
+
+	if (_batch != nullptr) {
+		_batch->Remove(this);
+		_batch = nullptr;
+	}
+	_load_stats.Milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Shader::IsReady() const {
+	return _is_ready;
+}
+
+void Shader::EnsureReady() const {
+	if (!_is_ready) {
+		const_cast<Shader*>(this)->Finish();
+	}
+}
+
+void Shader::Build(const std::string& vert_code, const std::string& frag_code) {
 	const char* vert_code_cstr = vert_code.c_str();
 	const char* frag_code_cstr = frag_code.c_str();
 
+	// Load and compile vertex shader
+	_pending->VertexShader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(_pending->VertexShader, 1, &vert_code_cstr, NULL);
+	glCompileShader(_pending->VertexShader);
+
+	// Load and compile fragment shader
+	_pending->FragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(_pending->FragmentShader, 1, &frag_code_cstr, NULL);
+	glCompileShader(_pending->FragmentShader);
+
+	// Link shader together to create a shader program, a failed compile shows up as a failed link
+	glAttachShader(_program_id, _pending->VertexShader);
+	glAttachShader(_program_id, _pending->FragmentShader);
+	ProgramCache::PrepareLink(_program_id);
+	glLinkProgram(_program_id);
+}
+
+bool Shader::CheckBuild() {
 	// Shader compilation control variables
 	int is_shader_compiled;
 	int are_shaders_linked;
 	char shader_compile_log[512];
 	char shader_link_log[512];
 
-	// Load and compile vertex shader
-	unsigned int vertex_shader;
-	vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex_shader, 1, &vert_code_cstr, NULL);
-	glCompileShader(vertex_shader);
-
 	// Check vertex shader compilation status
-	glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &is_shader_compiled);
+	glGetShaderiv(_pending->VertexShader, GL_COMPILE_STATUS, &is_shader_compiled);
 	if (!is_shader_compiled) {
-		glGetShaderInfoLog(vertex_shader, 512, NULL, shader_compile_log);
+		glGetShaderInfoLog(_pending->VertexShader, 512, NULL, shader_compile_log);
 		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << shader_compile_log << std::endl;
 	}
 
-	// Load and compile fragment shader
-	unsigned int fragment_shader;
-	fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment_shader, 1, &frag_code_cstr, NULL);
-	glCompileShader(fragment_shader);
-
 	// Check fragment shader compilation status
-	glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &is_shader_compiled);
+	glGetShaderiv(_pending->FragmentShader, GL_COMPILE_STATUS, &is_shader_compiled);
 	if (!is_shader_compiled) {
-		glGetShaderInfoLog(fragment_shader, 512, NULL, shader_compile_log);
+		glGetShaderInfoLog(_pending->FragmentShader, 512, NULL, shader_compile_log);
 		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << shader_compile_log << std::endl;
 	}
 
-	// Link shader together to create a shader program
-	_program_id = glCreateProgram();
-	glAttachShader(_program_id, vertex_shader);
-	glAttachShader(_program_id, fragment_shader);
-	glLinkProgram(_program_id);
-
 	// Check shader link status
 	glGetProgramiv(_program_id, GL_LINK_STATUS, &are_shaders_linked);
 	if (!are_shaders_linked) {
@@ -78,35 +226,234 @@ Shader::Shader(const char* vert_path, const char* frag_path) {
 	}
 
 	// delete already linked shaders
-	glDeleteShader(vertex_shader);
-	glDeleteShader(fragment_shader);
+	glDetachShader(_program_id, _pending->VertexShader);
+	glDetachShader(_program_id, _pending->FragmentShader);
+	glDeleteShader(_pending->VertexShader);
+	glDeleteShader(_pending->FragmentShader);
+
+	return are_shaders_linked != 0;
 }
 
 void Shader::Use() {
+	Finish();
 	glUseProgram(_program_id);
 }
 
+void Shader::SetBool(const char* name, bool value) const {
+	_uniform_stats.NameLookups++;
+	Set(UniformHandle<bool>{ FindUniform(name) }, value);
+}
+
+void Shader::SetInt(const char* name, int value) const {
+	_uniform_stats.NameLookups++;
+	Set(UniformHandle<int>{ FindUniform(name) }, value);
+}
+
+void Shader::SetFloat(const char* name, float value) const {
+	_uniform_stats.NameLookups++;
+	Set(UniformHandle<float>{ FindUniform(name) }, value);
+}
+
+void Shader::SetMatrix4(const char* name, const glm::mat4& value) const {
+	_uniform_stats.NameLookups++;
+	Set(UniformHandle<glm::mat4>{ FindUniform(name) }, value);
+}
+
+void Shader::SetVec3(const char* name, const glm::vec3& value) const {
+	_uniform_stats.NameLookups++;
+	Set(UniformHandle<glm::vec3>{ FindUniform(name) }, value);
+}
+
 void Shader::SetBool(const std::string& name, bool value) const {
-	glUniform1i(glGetUniformLocation(_program_id, name.c_str()), (int)value);
+	SetBool(name.c_str(), value);
 }
 
 void Shader::SetInt(const std::string& name, int value) const {
-	glUniform1i(glGetUniformLocation(_program_id, name.c_str()), value);
+	SetInt(name.c_str(), value);
 }
 
 void Shader::SetFloat(const std::string& name, float value) const {
-	glUniform1f(glGetUniformLocation(_program_id, name.c_str()), value);
+	SetFloat(name.c_str(), value);
 }
 
-void Shader::SetMatrix4(const std::string& name, glm::mat4 value) const {
-	glUniformMatrix4fv(glGetUniformLocation(_program_id, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+void Shader::SetMatrix4(const std::string& name, const glm::mat4& value) const {
+	SetMatrix4(name.c_str(), value);
 }
 
-void Shader::SetVec3(const std::string& name, glm::vec3 value) const {
-	glUniform3f(glGetUniformLocation(_program_id, name.c_str()), value.x, value.y, value.z);
+void Shader::SetVec3(const std::string& name, const glm::vec3& value) const {
+	SetVec3(name.c_str(), value);
+}
+
+void Shader::Set(UniformHandle<bool> handle, bool value) const {
+	// stored as the int GL gets
+	int int_value = (int)value;
+	if (IsChanged(handle.Slot, int_value)) {
+		glUniform1i(_uniforms[handle.Slot].Location, int_value);
+	}
+}
+
+void Shader::Set(UniformHandle<int> handle, int value) const {
+	if (IsChanged(handle.Slot, value)) {
+		glUniform1i(_uniforms[handle.Slot].Location, value);
+	}
+}
+
+void Shader::Set(UniformHandle<float> handle, float value) const {
+	if (IsChanged(handle.Slot, value)) {
+		glUniform1f(_uniforms[handle.Slot].Location, value);
+	}
+}
+
+void Shader::Set(UniformHandle<glm::mat4> handle, const glm::mat4& value) const {
+	if (IsChanged(handle.Slot, value)) {
+		glUniformMatrix4fv(_uniforms[handle.Slot].Location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+}
+
+void Shader::Set(UniformHandle<glm::vec3> handle, const glm::vec3& value) const {
+	if (IsChanged(handle.Slot, value)) {
+		glUniform3f(_uniforms[handle.Slot].Location, value.x, value.y, value.z);
+	}
 }
 
 unsigned const int Shader::GetId() const
 {
+	// callers bind the program themselves, see RenderQueue
+	EnsureReady();
 	return _program_id;
 }
+
+bool Shader::IsFromCache() const {
+	return _is_from_cache;
+}
+
+size_t Shader::GetUniformCount() const {
+	EnsureReady();
+	return _uniforms.size();
+}
+
+const MeshUniforms& Shader::GetMeshUniforms() const {
+	EnsureReady();
+	return _mesh_uniforms;
+}
+
+UniformStats Shader::GetUniformStats() {
+	return _uniform_stats;
+}
+
+void Shader::ResetUniformStats() {
+	_uniform_stats = UniformStats();
+}
+
+ShaderLoadStats Shader::GetLoadStats() {
+	return _load_stats;
+}
+
+void Shader::LoadUniforms() {
+	int uniform_count = 0;
+	int max_name_length = 0;
+	glGetProgramiv(_program_id, GL_ACTIVE_UNIFORMS, &uniform_count);
+	glGetProgramiv(_program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+	std::vector<char> name_buffer(max_name_length + 1);
+	for (int i = 0; i < uniform_count; i++) {
+		GLsizei name_length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(_program_id, (GLuint)i, (GLsizei)name_buffer.size(), &name_length, &size, &type, name_buffer.data());
+		std::string name(name_buffer.data(), name_length);
+
+		// members of uniform blocks have no location
+		int location = glGetUniformLocation(_program_id, name.c_str());
+		if (location < 0) {
+			continue;
+		}
+
+		// arrays of basic types are reported once as name[0], their elements take consecutive locations
+		if (size > 1 && name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+			std::string base_name = name.substr(0, name.size() - 3);
+			AddUniformName(base_name, (int)_uniforms.size());
+			for (int element = 0; element < size; element++) {
+				AddUniformName(base_name + "[" + std::to_string(element) + "]", AddUniform(location + element));
+			}
+		}
+		else {
+			AddUniformName(name, AddUniform(location));
+		}
+	}
+
+	// at most half full keeps probe chains short
+	size_t table_size = 16;
+	while (table_size < _uniform_names.size() * 2) {
+		table_size *= 2;
+	}
+	_uniform_table.assign(table_size, -1);
+	for (size_t i = 0; i < _uniform_names.size(); i++) {
+		size_t bucket = _uniform_names[i].Hash & (table_size - 1);
+		while (_uniform_table[bucket] >= 0) {
+			bucket = (bucket + 1) & (table_size - 1);
+		}
+		_uniform_table[bucket] = (int)i;
+	}
+}
+
+void Shader::LoadMeshUniforms() {
+	_mesh_uniforms.PositionOffset.Slot = FindUniform("vertex_position_offset");
+	_mesh_uniforms.PositionScale.Slot = FindUniform("vertex_position_scale");
+	_mesh_uniforms.OctahedralNormals.Slot = FindUniform("vertex_octahedral_normals");
+	for (unsigned int i = 0; i < MeshUniforms::SAMPLERS_PER_TYPE; i++) {
+		_mesh_uniforms.Samplers[MeshUniforms::GetSamplerSlot("diffuse", i)].Slot = FindUniform(("texture_diffuse" + std::to_string(i)).c_str());
+		_mesh_uniforms.Samplers[MeshUniforms::GetSamplerSlot("specular", i)].Slot = FindUniform(("texture_specular" + std::to_string(i)).c_str());
+	}
+	_mesh_uniforms.Samplers[MeshUniforms::GetSamplerSlot("splat", 0)].Slot = FindUniform("texture_splatmap");
+}
+
+int Shader::AddUniform(int location) {
+	Uniform uniform;
+	uniform.Location = location;
+	uniform.HasValue = false;
+	_uniforms.push_back(uniform);
+	return (int)_uniforms.size() - 1;
+}
+
+void Shader::AddUniformName(const std::string& name, int slot) {
+	UniformName uniform_name;
+	uniform_name.Name = name;
+	uniform_name.Hash = HashUniformName(name.c_str());
+	uniform_name.Slot = slot;
+	_uniform_names.push_back(uniform_name);
+}
+
+int Shader::FindUniform(const char* name) const {
+	EnsureReady();
+	if (_uniform_table.empty()) {
+		return -1;
+	}
+
+	uint32_t hash = HashUniformName(name);
+	size_t mask = _uniform_table.size() - 1;
+	for (size_t bucket = hash & mask; _uniform_table[bucket] >= 0; bucket = (bucket + 1) & mask) {
+		const UniformName& uniform_name = _uniform_names[_uniform_table[bucket]];
+		if (uniform_name.Hash == hash && uniform_name.Name == name) {
+			return uniform_name.Slot;
+		}
+	}
+	return -1;
+}
+
+template <typename T>
+bool Shader::IsChanged(int slot, const T& value) const {
+	if (slot < 0) {
+		return false;
+	}
+
+	Uniform& uniform = _uniforms[slot];
+	if (uniform.HasValue && std::memcmp(uniform.Value, &value, sizeof(T)) == 0) {
+		_uniform_stats.Skipped++;
+		return false;
+	}
+	std::memcpy(uniform.Value, &value, sizeof(T));
+	uniform.HasValue = true;
+	_uniform_stats.Calls++;
+	return true;
+}
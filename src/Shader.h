@@ -6,25 +6,172 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <memory>
+#include <vector>
 
+class ShaderBatch;
+
+// A uniform of one shader resolved ahead of time, so setting it needs no name lookup. Only valid with the
+// shader that handed it out. T is the C++ type the uniform is set with.
+template <typename T>
+struct UniformHandle {
+	int Slot = -1;
+
+	bool IsValid() const { return Slot >= 0; }
+};
+
+// Uniforms every mesh draw sets, resolved once per program so Mesh::Bind and RenderQueue::Bind need no name
+// lookups. Samplers are the texture_diffuse<n>, texture_specular<n> and texture_splatmap uniforms, by GetSamplerSlot.
+struct MeshUniforms {
+	static const unsigned int SAMPLERS_PER_TYPE = 4;
+	static const unsigned int SAMPLER_COUNT = SAMPLERS_PER_TYPE * 2 + 1;
+
+	UniformHandle<glm::vec3> PositionOffset;
+	UniformHandle<glm::vec3> PositionScale;
+	UniformHandle<bool> OctahedralNormals;
+	UniformHandle<int> Samplers[SAMPLER_COUNT];
+
+	// the sampler of the index-th texture of a type ("diffuse", "specular" or "splat"), -1 when there is none
+	static int GetSamplerSlot(const std::string& type, unsigned int index);
+};
+
+// glUniform calls since the last reset, for every shader
+struct UniformStats {
+	unsigned int Calls = 0;
+	// sets skipped because the program already held the value
+	unsigned int Skipped = 0;
+	// sets by name, which hash the name to find the uniform
+	unsigned int NameLookups = 0;
+};
+
+// programs created since start, for the startup report
+struct ShaderLoadStats {
+	unsigned int Programs = 0;
+	// linked from a ProgramCache binary instead of GLSL
+	unsigned int CachedPrograms = 0;
+	// main thread time reading, issuing compiles or loading, then waiting for and checking the link, all programs together
+	double Milliseconds = 0.0;
+};
+
+// Active uniforms are read once after linking into a flat table, setters find them there instead of asking
+// glGetUniformLocation, and remember the last value so setting the same value again issues no GL call.
+// That only holds while every uniform of the program is set through its Shader, hence no copies.
+//
+// Created against a ShaderBatch, the constructor only issues the compiles and the link, and the program is
+// finished, its status checked and its uniforms read, by the batch once the driver is done or by the first call
+// that needs it, whichever comes first.
 class Shader {
 public:
 	Shader(const char* vert_path, const char* frag_path);
+	Shader(const char* vert_path, const char* frag_path, ShaderBatch& batch);
+	// with a #define for each name after the #version line of both stages, see ShaderPermutations
+	Shader(const char* vert_path, const char* frag_path, const std::vector<std::string>& defines, ShaderBatch* batch = nullptr);
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+	~Shader();
 	
 	void Use();
 
+	// waits for the driver if the program is still being built in a batch
+	void Finish();
+	bool IsReady() const;
+
+	// the const char* overloads let string literals through without building a temporary std::string
+	void SetBool(const char* name, bool value) const;
+	void SetInt(const char* name, int value) const;
+	void SetFloat(const char* name, float value) const;
+	void SetMatrix4(const char* name, const glm::mat4& value) const;
+	void SetVec3(const char* name, const glm::vec3& value) const;
+
 	void SetBool(const std::string& name, bool value) const;
 	void SetInt(const std::string& name, int value) const;
 	void SetFloat(const std::string& name, float value) const;
-	void SetMatrix4(const std::string& name, glm::mat4 value) const;
-	void SetVec3(const std::string& name, glm::vec3 value) const;
+	void SetMatrix4(const std::string& name, const glm::mat4& value) const;
+	void SetVec3(const std::string& name, const glm::vec3& value) const;
+
+	// an invalid handle for a name that is not an active uniform, setting it does nothing
+	template <typename T>
+	UniformHandle<T> GetUniform(const char* name) const {
+		EnsureReady();
+		UniformHandle<T> handle;
+		handle.Slot = FindUniform(name);
+		return handle;
+	}
+
+	void Set(UniformHandle<bool> handle, bool value) const;
+	void Set(UniformHandle<int> handle, int value) const;
+	void Set(UniformHandle<float> handle, float value) const;
+	void Set(UniformHandle<glm::mat4> handle, const glm::mat4& value) const;
+	void Set(UniformHandle<glm::vec3> handle, const glm::vec3& value) const;
 
 	unsigned const int GetId() const;
+	size_t GetUniformCount() const;
+	const MeshUniforms& GetMeshUniforms() const;
+	// linked from a ProgramCache binary rather than compiled
+	bool IsFromCache() const;
+
+	static UniformStats GetUniformStats();
+	static void ResetUniformStats();
+	static ShaderLoadStats GetLoadStats();
 
 private:
+	struct Uniform {
+		int Location;
+		bool HasValue;
+		// the last value set, as the bytes of the C++ type
+		unsigned char Value[sizeof(glm::mat4)];
+	};
+
+	// an array's name and its first element share a uniform, so names are kept apart
+	struct UniformName {
+		std::string Name;
+		uint32_t Hash;
+		int Slot;
+	};
+
+	// shader objects of a program that was issued but not finished yet
+	struct PendingBuild {
+		unsigned int VertexShader;
+		unsigned int FragmentShader;
+		std::string CachePath;
+		uint64_t SourceHash;
+	};
+
 	unsigned int _program_id;
+	bool _is_from_cache;
+	bool _is_ready;
+	std::unique_ptr<PendingBuild> _pending;
+	// the batch that finishes the program, null once it is ready
+	ShaderBatch* _batch;
+	mutable std::vector<Uniform> _uniforms;
+	std::vector<UniformName> _uniform_names;
+	// open addressing over _uniform_names by hash, -1 for an empty bucket, a power of two in size
+	std::vector<int> _uniform_table;
+	MeshUniforms _mesh_uniforms;
+
+	static UniformStats _uniform_stats;
+	static ShaderLoadStats _load_stats;
+
+	friend class ShaderBatch;
+
+	// issues compiling and linking the program from GLSL, without asking for any status
+	void Build(const std::string& vert_code, const std::string& frag_code);
+	// logs compile and link errors of the issued build and frees its shader objects, false on any error
+	bool CheckBuild();
+	// for the const accessors, finishing does not change the program, only when it is usable
+	void EnsureReady() const;
+	// active uniforms of the linked program, array elements each under their own name
+	void LoadUniforms();
+	void LoadMeshUniforms();
+	int AddUniform(int location);
+	void AddUniformName(const std::string& name, int slot);
+	int FindUniform(const char* name) const;
+	// true when value differs from what the program holds, which is then updated
+	template <typename T>
+	bool IsChanged(int slot, const T& value) const;
 };
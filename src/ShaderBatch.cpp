@@ -0,0 +1,94 @@
+#include "ShaderBatch.h"
+
+#include <algorithm>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Shader.h"
+
+// glad is generated for GL 3.3, the KHR and ARB extensions share their enums
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+ShaderBatch::ShaderBatch(bool is_enabled) : _is_enabled(is_enabled) {
+	// the compiler threads have to be set before the first compile is issued to help it
+	if (_is_enabled) {
+		IsParallelCompileSupported();
+	}
+}
+
+ShaderBatch::~ShaderBatch() {
+	// every Shader detaches itself in ~Shader, anything left is only unlinked, never finished here
+	for (Shader* shader : _pending) {
+		shader->_batch = nullptr;
+	}
+}
+
+void ShaderBatch::Update() {
+	// without the extension there is no status to ask for that does not wait
+	if (_pending.empty() || !IsParallelCompileSupported()) {
+		return;
+	}
+
+	std::vector<Shader*> completed;
+	for (Shader* shader : _pending) {
+		int is_complete = 0;
+		glGetProgramiv(shader->_program_id, GL_COMPLETION_STATUS_KHR, &is_complete);
+		if (is_complete) {
+			completed.push_back(shader);
+		}
+	}
+	// finishing removes the shader from _pending
+	for (Shader* shader : completed) {
+		shader->Finish();
+	}
+}
+
+void ShaderBatch::Finish() {
+	std::vector<Shader*> pending = _pending;
+	for (Shader* shader : pending) {
+		shader->Finish();
+	}
+}
+
+bool ShaderBatch::IsEnabled() const {
+	return _is_enabled;
+}
+
+size_t ShaderBatch::GetPendingCount() const {
+	return _pending.size();
+}
+
+bool ShaderBatch::IsParallelCompileSupported() {
+	static bool is_supported = []() {
+		MaxShaderCompilerThreadsProc max_threads = nullptr;
+		if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+			max_threads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		}
+		else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile")) {
+			max_threads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+		}
+		if (max_threads == nullptr) {
+			return false;
+		}
+		// as many as the driver likes
+		max_threads(0xFFFFFFFF);
+		return true;
+	}();
+	return is_supported;
+}
+
+void ShaderBatch::Add(Shader* shader) {
+	_pending.push_back(shader);
+}
+
+void ShaderBatch::Remove(Shader* shader) {
+	_pending.erase(std::remove(_pending.begin(), _pending.end(), shader), _pending.end());
+}
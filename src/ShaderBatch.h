@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class Shader;
+
+// Programs whose compiles and links are all issued before any status is asked for, so the driver can work on
+// them side by side instead of one after the other, with KHR_parallel_shader_compile on its own threads.
+// Asking for a status waits for that program, so a program is only finished by Update once the driver reports
+// it complete, or by the Shader itself when it is first used. With a disabled batch the Shader constructor
+// finishes the program right away like before, to compare startup times.
+class ShaderBatch {
+public:
+	// needs the context current
+	explicit ShaderBatch(bool is_enabled = true);
+	ShaderBatch(const ShaderBatch&) = delete;
+	ShaderBatch& operator=(const ShaderBatch&) = delete;
+	// detaches what is left without finishing it, the shaders finish themselves when used
+	~ShaderBatch();
+
+	// finishes the programs the driver is done with, without waiting, once per frame
+	void Update();
+	// finishes every program, waiting for the driver
+	void Finish();
+
+	bool IsEnabled() const;
+	size_t GetPendingCount() const;
+
+	// KHR or ARB_parallel_shader_compile, the thread count is raised on the first call
+	static bool IsParallelCompileSupported();
+
+private:
+	friend class Shader;
+
+	bool _is_enabled;
+	std::vector<Shader*> _pending;
+
+	void Add(Shader* shader);
+	void Remove(Shader* shader);
+};
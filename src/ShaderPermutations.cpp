@@ -0,0 +1,63 @@
+#include "ShaderPermutations.h"
+
+#include <chrono>
+#include <iostream>
+
+ShaderVariantStats ShaderPermutations::_stats;
+
+ShaderPermutations::ShaderPermutations(const char* vert_path, const char* frag_path, const std::vector<std::string>& features)
+	: _vert_path(vert_path), _frag_path(frag_path), _features(features) {
+	if (_features.size() > 32) {
+		std::cout << "ERROR::SHADER_PERMUTATIONS::TOO_MANY_FEATURES: " << _frag_path << std::endl;
+		_features.resize(32);
+	}
+}
+
+Shader& ShaderPermutations::Get(uint32_t mask) {
+	std::unordered_map<uint32_t, std::unique_ptr<Shader>>::iterator found = _variants.find(mask);
+	if (found != _variants.end()) {
+		return *found->second;
+	}
+	return Create(mask, nullptr);
+}
+
+void ShaderPermutations::Prepare(uint32_t mask, ShaderBatch& batch) {
+	if (_variants.find(mask) == _variants.end()) {
+		Create(mask, &batch);
+	}
+}
+
+Shader& ShaderPermutations::Create(uint32_t mask, ShaderBatch* batch) {
+	std::vector<std::string> defines;
+	std::string names;
+	for (size_t i = 0; i < _features.size(); i++) {
+		if (mask & (1u << i)) {
+			defines.push_back(_features[i]);
+			names += " " + _features[i];
+		}
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::unique_ptr<Shader> variant(new Shader(_vert_path.c_str(), _frag_path.c_str(), defines, batch));
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	_stats.Variants++;
+	if (variant->IsFromCache()) {
+		_stats.CachedVariants++;
+	}
+	_stats.Milliseconds += milliseconds;
+	std::cout << "SHADER VARIANT " << _frag_path << " [" << (names.empty() ? " none" : names) << " ]: " << milliseconds << " ms"
+		<< (variant->IsFromCache() ? " from the program cache" : "") << (variant->IsReady() ? "" : " to issue, compiling in a batch") << std::endl;
+
+	Shader& shader = *variant;
+	_variants[mask] = std::move(variant);
+	return shader;
+}
+
+size_t ShaderPermutations::GetVariantCount() const {
+	return _variants.size();
+}
+
+ShaderVariantStats ShaderPermutations::GetStats() {
+	return _stats;
+}
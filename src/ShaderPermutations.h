@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Shader.h"
+
+// variants built since start, for the debug menu
+struct ShaderVariantStats {
+	unsigned int Variants = 0;
+	// linked from a ProgramCache binary instead of GLSL
+	unsigned int CachedVariants = 0;
+	// on the main thread, a variant issued in a ShaderBatch only counts issuing it
+	double Milliseconds = 0.0;
+};
+
+// Variants of one vertex and fragment shader pair, where bit i of a mask adds #define features[i] to both stages.
+// Features a frame does not use are compiled out instead of branched over at runtime. A variant is built the
+// first time its mask is asked for and kept, each in its own program cache file, so switching a feature costs
+// one compile per new combination and nothing after that.
+//
+// Every variant is a separate program with its own uniforms, set them after Get like for any other Shader.
+class ShaderPermutations {
+public:
+	// at most 32 features
+	ShaderPermutations(const char* vert_path, const char* frag_path, const std::vector<std::string>& features);
+	ShaderPermutations(const ShaderPermutations&) = delete;
+	ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+	// the variant of mask, built on the first call, which stalls that frame
+	Shader& Get(uint32_t mask);
+	// issues the variant of mask in batch, for the ones known to be needed
+	void Prepare(uint32_t mask, ShaderBatch& batch);
+
+	size_t GetVariantCount() const;
+	static ShaderVariantStats GetStats();
+
+private:
+	std::string _vert_path;
+	std::string _frag_path;
+	std::vector<std::string> _features;
+	std::unordered_map<uint32_t, std::unique_ptr<Shader>> _variants;
+
+	static ShaderVariantStats _stats;
+
+	Shader& Create(uint32_t mask, ShaderBatch* batch);
+};
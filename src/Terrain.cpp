@@ -1,22 +1,27 @@
 #include "Terrain.h"
 
-Terrain::Terrain(int size, std::string heightmap_path, std::string texturemap_path) {
-    _texture0 = { Texture::Load(texturemap_path), "diffuse", texturemap_path };
+#include "MemoryStats.h"
+#include "MeshProcessing.h"
+
+Terrain::Terrain(int size, std::string heightmap_path, std::string texturemap_path, MeshOptions options) : _options(options) {
+    _texture0 = { AcquireTexture(texturemap_path), "diffuse", texturemap_path };
     _size = size;
     _is_single_texture = true;
     _terrain_model = Generate(size, heightmap_path);
 }
 
-Terrain::Terrain(int size, std::string heightmap_path, std::string splatmap_path, std::string texture0_path, std::string texture1_path, std::string texture2_path) {
-    _texture0 = { Texture::Load(texture0_path), "diffuse", texture0_path };
-    _texture1 = { Texture::Load(texture1_path), "diffuse", texture1_path };
-    _texture2 = { Texture::Load(texture2_path), "diffuse", texture2_path };
-    _splatmap_texture = { Texture::Load(splatmap_path), "splat", splatmap_path };
+Terrain::Terrain(int size, std::string heightmap_path, std::string splatmap_path, std::string texture0_path, std::string texture1_path, std::string texture2_path, MeshOptions options) : _options(options) {
+    // decoded side by side
+    _texture_references = TextureCache::GetShared().AcquireAll({ texture0_path, texture1_path, texture2_path, splatmap_path });
+    _texture0 = { _texture_references[0].GetId(), "diffuse", texture0_path };
+    _texture1 = { _texture_references[1].GetId(), "diffuse", texture1_path };
+    _texture2 = { _texture_references[2].GetId(), "diffuse", texture2_path };
+    _splatmap_texture = { _texture_references[3].GetId(), "splat", splatmap_path };
     _size = size;
     _terrain_model = Generate(size, heightmap_path);
 }
 
-Model Terrain::GetModel() {
+Model& Terrain::GetModel() {
     return _terrain_model;
 }
 
@@ -24,7 +29,14 @@ int Terrain::GetSize() {
     return _size;
 }
 
+unsigned int Terrain::AcquireTexture(const std::string& path) {
+    _texture_references.push_back(TextureCache::GetShared().Acquire(path));
+    return _texture_references.back().GetId();
+}
+
 Model Terrain::Generate(int size, std::string heightmap_path) {
+    ScopedLoadReport load_report(heightmap_path);
+
     int SIZE = size;
 
 	std::vector<Vertex> vertices;
@@ -42,6 +54,11 @@ Model Terrain::Generate(int size, std::string heightmap_path) {
     }
 
 	int total_vertices = vertex_count * vertex_count;
+    if (vertex_count > 1) {
+        vertices.reserve(total_vertices);
+        indices.reserve((vertex_count - 1) * (vertex_count - 1) * 6);
+    }
+    textures.reserve(4);
 
     for (int i = 0; i < vertex_count; i++) {
         for (int j = 0; j < vertex_count; j++) {
@@ -78,13 +95,30 @@ Model Terrain::Generate(int size, std::string heightmap_path) {
         textures.push_back(_splatmap_texture);
     }
 
-    std::vector<Mesh> meshes;
+    // the parts share one quantization so they can be batched when they share an arena
+    MeshOptions options = _options;
+    if (options.Arena != nullptr && !options.HasQuantizationBounds) {
+        options.QuantizationBounds = Bounds::FromPoints(vertices, [](const Vertex& vertex) { return vertex.Position; }).Box;
+        options.HasQuantizationBounds = true;
+    }
+
+    // large heightmaps are split into parts that fit 16 bit indices
+    std::vector<MeshGeometry> parts = MeshProcessing::SplitByVertexCount(std::move(vertices), std::move(indices), Mesh::MAX_SHORT_INDEX_VERTICES);
 
-    meshes.push_back(Mesh(vertices, indices, textures));
+    std::vector<Mesh> meshes;
+    meshes.reserve(parts.size());
+    for (MeshGeometry& part : parts) {
+        if (_options.Optimize) {
+            MeshProcessing::Optimize(part, heightmap_path);
+        }
+        meshes.push_back(Mesh(std::move(part.Vertices), std::move(part.Indices), textures, options));
+    }
 
     stbi_image_free(data); 
 
-    return Model(meshes);
+    Model model(std::move(meshes));
+    model.PrintMemoryReport(heightmap_path);
+    return model;
 }
 
 float Terrain::GetHeight(int x, int z, unsigned char* heightmap, int heightmap_size) {
@@ -8,21 +8,23 @@
 
 #include "Model.h"
 #include "Mesh.h"
+#include "TextureCache.h"
 #include "Vertex.h"
 
 #include <stb_image/stb_image.h>
 
 class Terrain {
 public:
-	Terrain(int size, std::string heightmap_path, std::string texturemap_path);
-	Terrain(int size, std::string heightmap_path, std::string splatmap_path, std::string texture0_path, std::string texture1_path, std::string texture2_path);
+	Terrain(int size, std::string heightmap_path, std::string texturemap_path, MeshOptions options = MeshOptions());
+	Terrain(int size, std::string heightmap_path, std::string splatmap_path, std::string texture0_path, std::string texture1_path, std::string texture2_path, MeshOptions options = MeshOptions());
 
-	Model GetModel();
+	Model& GetModel();
 
 	int GetSize();
 
 private:
 	Model Generate(int size, std::string heightmap_path);
+	unsigned int AcquireTexture(const std::string& path);
 	
 	float GetHeight(int x, int z, unsigned char* heightmap, int heightmap_size);
 	glm::vec3 GetNormal(int x, int z, unsigned char* heightmap, int heightmap_size);
@@ -33,7 +35,10 @@ private:
 	Texture _texture1;
 	Texture _texture2;
 	Texture _splatmap_texture;
+	// keep the textures above in the texture cache
+	std::vector<TextureReference> _texture_references;
 	int _size;
+	MeshOptions _options;
 
 	
 };
\ No newline at end of file
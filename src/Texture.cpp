@@ -1,5 +1,20 @@
 #include "Texture.h"
 
+#include "TextureCooker.h"
+
+bool TextureImage::IsValid() const {
+	return Data != nullptr || CompressedFormat != 0;
+}
+
+size_t TextureImage::GetGpuBytes() const {
+	if (CompressedFormat != 0) {
+		return CompressedData.size();
+	}
+	// RGB is padded to 4 bytes by drivers, mipmaps add a third
+	int bytes_per_pixel = Components == 3 ? 4 : Components;
+	return (size_t)Width * Height * bytes_per_pixel * 4 / 3;
+}
+
 Texture::Texture()
 {
 	Id = 0;
@@ -11,38 +26,116 @@ Texture::Texture(unsigned int id, std::string type, std::string path) : Id(id),
 }
 
 unsigned int Texture::Load(std::string path) {
+	TextureImage image = Decode(path);
+	return Upload(image);
+}
+
+TextureImage Texture::Decode(const std::string& path) {
+	if (TextureCooker::IsEnabled()) {
+		return TextureCooker::Load(path);
+	}
+
+	TextureImage image;
+	image.Data = stbi_load(path.c_str(), &image.Width, &image.Height, &image.Components, 0);
+	if (!image.Data) {
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+	}
+	return image;
+}
+
+TextureImage Texture::Decode(const unsigned char* data, size_t size, const std::string& path) {
+	TextureImage image;
+	image.Data = stbi_load_from_memory(data, (int)size, &image.Width, &image.Height, &image.Components, 0);
+	if (!image.Data) {
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+	}
+	return image;
+}
+
+// pixel format of an uncompressed image
+static GLenum GetPixelFormat(int components) {
+	if (components == 1) {
+		return GL_RED;
+	}
+	else if (components == 2) {
+		return GL_RG;
+	}
+	else if (components == 3) {
+		return GL_RGB;
+	}
+	return GL_RGBA;
+}
+
+static void SetSamplerParameters() {
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+unsigned int Texture::Upload(TextureImage& image) {
 	unsigned int texture_id;
 	glGenTextures(1, &texture_id);
 
-	int width, height, n_components;
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &n_components, 0);
-	if (data) {
-		GLenum format;
-		if (n_components == 1) {
-			format = GL_RED;
-		}
-		else if (n_components == 3) {
-			format = GL_RGB;
-		}
-		else if (n_components == 4) {
-			format = GL_RGBA;
+	if (image.CompressedFormat != 0) {
+		// the whole chain is cooked, nothing to generate
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		for (size_t level = 0; level < image.Mips.size(); level++) {
+			const TextureMip& mip = image.Mips[level];
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, image.CompressedFormat, mip.Width, mip.Height, 0, (GLsizei)mip.Size,
+				image.CompressedData.data() + mip.Offset);
 		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.Mips.size() - 1);
+		SetSamplerParameters();
+	}
+	else if (image.Data) {
+		GLenum format = GetPixelFormat(image.Components);
 
 		glBindTexture(GL_TEXTURE_2D, texture_id);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, image.Width, image.Height, 0, format, GL_UNSIGNED_BYTE, image.Data);
 		glGenerateMipmap(GL_TEXTURE_2D);
+		SetSamplerParameters();
+	}
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	Free(image);
+	return texture_id;
+}
 
-		stbi_image_free(data);
+unsigned int Texture::Upload(TextureImage& image, UploadRing& staging) {
+	unsigned int texture_id;
+	glGenTextures(1, &texture_id);
+
+	// levels are allocated empty, NULL data is fine for compressed formats too
+	if (image.CompressedFormat != 0) {
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		for (size_t level = 0; level < image.Mips.size(); level++) {
+			const TextureMip& mip = image.Mips[level];
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, image.CompressedFormat, mip.Width, mip.Height, 0, (GLsizei)mip.Size, NULL);
+			staging.QueueTexture(texture_id, (int)level, image.CompressedFormat, true, mip.Width, mip.Height,
+				image.CompressedData.data() + mip.Offset, mip.Size, false);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.Mips.size() - 1);
+		SetSamplerParameters();
 	}
-	else {
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
+	else if (image.Data) {
+		GLenum format = GetPixelFormat(image.Components);
+
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, image.Width, image.Height, 0, format, GL_UNSIGNED_BYTE, NULL);
+		// the other levels are generated once the last rows are in
+		glGenerateMipmap(GL_TEXTURE_2D);
+		SetSamplerParameters();
+		staging.QueueTexture(texture_id, 0, format, false, image.Width, image.Height, image.Data,
+			(size_t)image.Width * image.Height * image.Components, true);
 	}
 
 	return texture_id;
 }
+
+void Texture::Free(TextureImage& image) {
+	stbi_image_free(image.Data);
+	image.Data = nullptr;
+	image.CompressedFormat = 0;
+	std::vector<TextureMip>().swap(image.Mips);
+	std::vector<unsigned char>().swap(image.CompressedData);
+}
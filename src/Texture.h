@@ -10,6 +10,35 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <vector>
+
+#include "UploadRing.h"
+
+// one level of a block compressed mip chain
+struct TextureMip {
+	int Width;
+	int Height;
+	size_t Offset;
+	size_t Size;
+};
+
+// pixels of an image file, decoded on any thread and uploaded with Texture::Upload on the GL thread
+struct TextureImage {
+	int Width = 0;
+	int Height = 0;
+	int Components = 0;
+	// nullptr when decoding failed
+	unsigned char* Data = nullptr;
+	// when not 0, the image is a block compressed mip chain of this GL format in CompressedData instead of Data
+	unsigned int CompressedFormat = 0;
+	std::vector<TextureMip> Mips;
+	std::vector<unsigned char> CompressedData;
+
+	bool IsValid() const;
+	// VRAM once uploaded, mipmaps included
+	size_t GetGpuBytes() const;
+};
+
 class Texture {
 public:
 	unsigned int Id;
@@ -20,4 +49,14 @@ public:
 	Texture(unsigned int id, std::string type, std::string path);
 
 	static unsigned int Load(std::string path);
+	// Load split in its CPU and GL halves, Upload frees the image. Decode prefers a cooked block compressed
+	// file next to the source while TextureCooker is enabled.
+	static TextureImage Decode(const std::string& path);
+	// from a file already in memory, path is only for the error message
+	static TextureImage Decode(const unsigned char* data, size_t size, const std::string& path);
+	static unsigned int Upload(TextureImage& image);
+	// allocates the texture and queues its pixels on staging, the image is left as is and has to stay valid
+	// until the ring has issued them
+	static unsigned int Upload(TextureImage& image, UploadRing& staging);
+	static void Free(TextureImage& image);
 };
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <cctype>
+
+#ifdef _WIN32
+#include <direct.h>
+#define getcwd _getcwd
+#else
+#include <unistd.h>
+#endif
+
+#include "MeshCache.h"
+#include "TextureDecodeBatch.h"
+
+TextureReference::TextureReference() : _id(0) {
+}
+
+TextureReference::TextureReference(unsigned int id) : _id(id) {
+}
+
+TextureReference::TextureReference(TextureReference&& other) noexcept : _id(other._id) {
+	other._id = 0;
+}
+
+TextureReference& TextureReference::operator=(TextureReference&& other) noexcept {
+	if (this != &other) {
+		if (_id != 0) {
+			TextureCache::GetShared().Release(_id);
+		}
+		_id = other._id;
+		other._id = 0;
+	}
+	return *this;
+}
+
+TextureReference::~TextureReference() {
+	if (_id != 0) {
+		TextureCache::GetShared().Release(_id);
+	}
+}
+
+unsigned int TextureReference::GetId() const {
+	return _id;
+}
+
+TextureCache::TextureCache() {
+}
+
+TextureCache& TextureCache::GetShared() {
+	static TextureCache shared_cache;
+	return shared_cache;
+}
+
+std::string TextureCache::Canonicalize(const std::string& path) {
+	std::string full_path = path;
+	std::replace(full_path.begin(), full_path.end(), '\\', '/');
+	bool is_absolute = !full_path.empty() && (full_path[0] == '/' || (full_path.size() > 1 && full_path[1] == ':'));
+	if (!is_absolute) {
+		char directory[4096];
+		if (getcwd(directory, sizeof(directory)) != nullptr) {
+			full_path = std::string(directory) + "/" + full_path;
+			std::replace(full_path.begin(), full_path.end(), '\\', '/');
+		}
+	}
+
+	std::vector<std::string> parts;
+	size_t start = 0;
+	while (start <= full_path.size()) {
+		size_t end = full_path.find('/', start);
+		if (end == std::string::npos) {
+			end = full_path.size();
+		}
+		std::string part = full_path.substr(start, end - start);
+		if (part == "..") {
+			if (!parts.empty()) {
+				parts.pop_back();
+			}
+		}
+		else if (!part.empty() && part != ".") {
+			parts.push_back(part);
+		}
+		start = end + 1;
+	}
+
+	// a drive letter stays the first part on Windows
+	bool is_rooted = !full_path.empty() && full_path[0] == '/';
+	std::string canonical_path;
+	for (size_t i = 0; i < parts.size(); i++) {
+		if (i > 0 || is_rooted) {
+			canonical_path += "/";
+		}
+		canonical_path += parts[i];
+	}
+#ifdef _WIN32
+	std::transform(canonical_path.begin(), canonical_path.end(), canonical_path.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+#endif
+	return canonical_path;
+}
+
+uint64_t TextureCache::HashContent(const std::string& canonical_path) {
+	return MeshCache::HashFile(canonical_path);
+}
+
+bool TextureCache::Contains(const std::string& canonical_path) const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _ids_by_path.count(canonical_path) > 0;
+}
+
+bool TextureCache::ContainsContent(uint64_t content_hash) const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return content_hash != 0 && _ids_by_content.count(content_hash) > 0;
+}
+
+TextureReference TextureCache::Acquire(const std::string& canonical_path, uint64_t content_hash, TextureImage& image,
+	UploadRing* staging) {
+	unsigned int id = 0;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (AcquireCached(canonical_path, 0, id)) {
+			Texture::Free(image);
+			return TextureReference(id);
+		}
+	}
+
+	// hashing and decoding read whole files, lookups from the pool threads must not wait on them
+	if (content_hash == 0) {
+		content_hash = HashContent(canonical_path);
+	}
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (AcquireCached(canonical_path, content_hash, id)) {
+			Texture::Free(image);
+			return TextureReference(id);
+		}
+	}
+
+	// skipped by the decoder as cached, but released since
+	if (!image.IsValid()) {
+		image = Texture::Decode(canonical_path);
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	// the maps may have changed while the lock was not held
+	if (AcquireCached(canonical_path, content_hash, id)) {
+		Texture::Free(image);
+		return TextureReference(id);
+	}
+
+	Entry entry;
+	entry.RefCount = 1;
+	entry.GpuBytes = image.GetGpuBytes();
+	entry.ContentHash = content_hash;
+
+	id = staging != nullptr ? Texture::Upload(image, *staging) : Texture::Upload(image);
+	_entries[id] = entry;
+	_ids_by_path[canonical_path] = id;
+	if (content_hash != 0) {
+		_ids_by_content[content_hash] = id;
+	}
+	_stats.Misses++;
+	_stats.TextureCount++;
+	_stats.GpuBytes += entry.GpuBytes;
+	return TextureReference(id);
+}
+
+bool TextureCache::AcquireCached(const std::string& canonical_path, uint64_t content_hash, unsigned int& id) {
+	std::unordered_map<std::string, unsigned int>::const_iterator path_it = _ids_by_path.find(canonical_path);
+	if (path_it == _ids_by_path.end() && content_hash != 0) {
+		// the same bytes under another path
+		std::unordered_map<uint64_t, unsigned int>::const_iterator content_it = _ids_by_content.find(content_hash);
+		if (content_it != _ids_by_content.end()) {
+			path_it = _ids_by_path.emplace(canonical_path, content_it->second).first;
+		}
+	}
+	if (path_it == _ids_by_path.end()) {
+		return false;
+	}
+
+	id = path_it->second;
+	Entry& entry = _entries[id];
+	entry.RefCount++;
+	_stats.Hits++;
+	_stats.GpuBytesSaved += entry.GpuBytes;
+	return true;
+}
+
+TextureReference TextureCache::Acquire(const std::string& path) {
+	TextureImage image;
+	return Acquire(Canonicalize(path), 0, image);
+}
+
+std::vector<TextureReference> TextureCache::AcquireAll(const std::vector<std::string>& paths) {
+	std::vector<TextureReference> references(paths.size());
+	std::vector<std::string> canonical_paths(paths.size());
+	TextureDecodeBatch batch;
+	for (size_t i = 0; i < paths.size(); i++) {
+		canonical_paths[i] = Canonicalize(paths[i]);
+		if (Contains(canonical_paths[i])) {
+			TextureImage image;
+			references[i] = Acquire(canonical_paths[i], 0, image);
+		}
+		else {
+			batch.Add(i, canonical_paths[i]);
+		}
+	}
+
+	DecodedTexture decoded;
+	while (batch.Next(decoded, true)) {
+		references[decoded.Index] = Acquire(canonical_paths[decoded.Index], 0, decoded.Image);
+	}
+	batch.PrintReport(std::to_string(paths.size()) + " textures");
+	return references;
+}
+
+TextureCacheStats TextureCache::GetStats() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _stats;
+}
+
+void TextureCache::PrintReport() const {
+	TextureCacheStats stats = GetStats();
+	std::cout << "TEXTURE CACHE: " << stats.TextureCount << " textures, " << stats.GpuBytes / (1024.0 * 1024.0) << " MB, "
+		<< stats.Hits << " hits, " << stats.Misses << " misses, " << stats.GpuBytesSaved / (1024.0 * 1024.0) << " MB saved" << std::endl;
+}
+
+void TextureCache::Release(unsigned int id) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::unordered_map<unsigned int, Entry>::iterator entry_it = _entries.find(id);
+	if (entry_it == _entries.end() || --entry_it->second.RefCount > 0) {
+		return;
+	}
+
+	// every path aliasing the texture goes with it
+	for (std::unordered_map<std::string, unsigned int>::iterator it = _ids_by_path.begin(); it != _ids_by_path.end();) {
+		if (it->second == id) {
+			it = _ids_by_path.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	if (entry_it->second.ContentHash != 0) {
+		_ids_by_content.erase(entry_it->second.ContentHash);
+	}
+	_stats.TextureCount--;
+	_stats.GpuBytes -= entry_it->second.GpuBytes;
+	_entries.erase(entry_it);
+
+	glDeleteTextures(1, &id);
+}
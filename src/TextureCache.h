@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Texture.h"
+
+// one reference to a texture of the TextureCache, released when destroyed
+class TextureReference {
+public:
+	TextureReference();
+	explicit TextureReference(unsigned int id);
+	TextureReference(const TextureReference&) = delete;
+	TextureReference& operator=(const TextureReference&) = delete;
+	TextureReference(TextureReference&& other) noexcept;
+	TextureReference& operator=(TextureReference&& other) noexcept;
+	~TextureReference();
+
+	unsigned int GetId() const;
+
+private:
+	unsigned int _id;
+};
+
+struct TextureCacheStats {
+	unsigned int Hits = 0;
+	unsigned int Misses = 0;
+	size_t TextureCount = 0;
+	size_t GpuBytes = 0;
+	// what the hits would have uploaded again
+	size_t GpuBytesSaved = 0;
+};
+
+// Process wide cache of uploaded textures shared by every model and terrain. Textures are found by canonical path,
+// then by a hash of the file's bytes, so one image under two paths is uploaded once. Each user holds a
+// TextureReference and the texture is deleted with the last one, so every reference has to be gone before the context.
+//
+// Lookups may come from any thread, Acquire and releasing a reference only from the GL thread.
+class TextureCache {
+public:
+	TextureCache();
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	static TextureCache& GetShared();
+
+	// absolute, forward slashes, no . or .. parts, lower case on Windows
+	static std::string Canonicalize(const std::string& path);
+	// 0 when the file cannot be read
+	static uint64_t HashContent(const std::string& canonical_path);
+
+	// whether decoding can be skipped because the texture is already uploaded
+	bool Contains(const std::string& canonical_path) const;
+	bool ContainsContent(uint64_t content_hash) const;
+
+	// the texture of a canonical path, uploaded from image on a miss, decoded here if the image is empty.
+	// The image is freed either way, a content hash of 0 is computed when it is needed. With staging a miss
+	// queues the pixels there and leaves the image to the caller, who keeps it until they are issued.
+	TextureReference Acquire(const std::string& canonical_path, uint64_t content_hash, TextureImage& image,
+		UploadRing* staging = nullptr);
+	// the same for a path as given, decoding on the calling thread
+	TextureReference Acquire(const std::string& path);
+	// the same for several paths, in their order, with the misses decoded on the thread pool and uploaded as they finish
+	std::vector<TextureReference> AcquireAll(const std::vector<std::string>& paths);
+
+	TextureCacheStats GetStats() const;
+	void PrintReport() const;
+
+private:
+	friend class TextureReference;
+
+	struct Entry {
+		unsigned int RefCount;
+		size_t GpuBytes;
+		uint64_t ContentHash;
+	};
+
+	std::unordered_map<std::string, unsigned int> _ids_by_path;
+	std::unordered_map<uint64_t, unsigned int> _ids_by_content;
+	std::unordered_map<unsigned int, Entry> _entries;
+	TextureCacheStats _stats;
+	mutable std::mutex _mutex;
+
+	// a hit by path, or by content unless the hash is 0, counted and referenced, with _mutex held
+	bool AcquireCached(const std::string& canonical_path, uint64_t content_hash, unsigned int& id);
+	void Release(unsigned int id);
+};
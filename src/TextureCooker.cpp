@@ -0,0 +1,449 @@
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "MappedFile.h"
+#include "MeshCache.h"
+
+// glad is generated for GL 3.3 core, S3TC is an extension every desktop driver has
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+static const char MAGIC[8] = { 'L', 'O', 'G', 'L', 'T', 'E', 'X', '\0' };
+static const size_t BLOCK_ALIGNMENT = 16;
+
+std::atomic<bool> TextureCooker::_is_enabled(false);
+
+// 4x4 texels as RGBA, edge blocks repeat the last row and column
+struct TexelBlock {
+	unsigned char Texels[16][4];
+};
+
+static TexelBlock ReadBlock(const unsigned char* rgba, int width, int height, int block_x, int block_y) {
+	TexelBlock block;
+	for (int y = 0; y < 4; y++) {
+		int source_y = std::min(block_y * 4 + y, height - 1);
+		for (int x = 0; x < 4; x++) {
+			int source_x = std::min(block_x * 4 + x, width - 1);
+			std::memcpy(block.Texels[y * 4 + x], rgba + ((size_t)source_y * width + source_x) * 4, 4);
+		}
+	}
+	return block;
+}
+
+static uint16_t ToRgb565(const float color[3]) {
+	int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+	int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void FromRgb565(uint16_t color, int rgb[3]) {
+	int r = (color >> 11) & 31;
+	int g = (color >> 5) & 63;
+	int b = color & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Range fit along the principal axis of the block's colors: the endpoints are the texels furthest apart on the axis,
+// pulled in by 1/16 of the range, and every texel takes the nearest of the four palette colors. Every loop has a
+// fixed trip count over the 16 texels for the compiler to unroll and vectorize.
+static void EncodeBc1(const TexelBlock& block, unsigned char* output) {
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 3; c++) {
+			mean[c] += block.Texels[i][c];
+		}
+	}
+	for (int c = 0; c < 3; c++) {
+		mean[c] /= 16.0f;
+	}
+
+	float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++) {
+		float r = block.Texels[i][0] - mean[0];
+		float g = block.Texels[i][1] - mean[1];
+		float b = block.Texels[i][2] - mean[2];
+		covariance[0] += r * r;
+		covariance[1] += r * g;
+		covariance[2] += r * b;
+		covariance[3] += g * g;
+		covariance[4] += g * b;
+		covariance[5] += b * b;
+	}
+
+	// a few power iterations find the principal axis well enough
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 4; iteration++) {
+		float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+		float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+		float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+		float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+		if (length < 1e-6f) {
+			break;
+		}
+		axis[0] = x / length;
+		axis[1] = y / length;
+		axis[2] = z / length;
+	}
+
+	float min_projection = 1e30f;
+	float max_projection = -1e30f;
+	int min_texel = 0;
+	int max_texel = 0;
+	for (int i = 0; i < 16; i++) {
+		float projection = block.Texels[i][0] * axis[0] + block.Texels[i][1] * axis[1] + block.Texels[i][2] * axis[2];
+		if (projection < min_projection) {
+			min_projection = projection;
+			min_texel = i;
+		}
+		if (projection > max_projection) {
+			max_projection = projection;
+			max_texel = i;
+		}
+	}
+
+	float endpoints[2][3];
+	for (int c = 0; c < 3; c++) {
+		float inset = (block.Texels[max_texel][c] - block.Texels[min_texel][c]) / 16.0f;
+		endpoints[0][c] = block.Texels[max_texel][c] - inset;
+		endpoints[1][c] = block.Texels[min_texel][c] + inset;
+	}
+	uint16_t color0 = ToRgb565(endpoints[0]);
+	uint16_t color1 = ToRgb565(endpoints[1]);
+	// color0 above color1 selects the four color mode, BC3 decodes its colors that way regardless
+	if (color0 < color1) {
+		std::swap(color0, color1);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		int palette[4][3];
+		FromRgb565(color0, palette[0]);
+		FromRgb565(color1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; i++) {
+			int best_index = 0;
+			int best_distance = 1 << 30;
+			for (int p = 0; p < 4; p++) {
+				int r = block.Texels[i][0] - palette[p][0];
+				int g = block.Texels[i][1] - palette[p][1];
+				int b = block.Texels[i][2] - palette[p][2];
+				int distance = r * r + g * g + b * b;
+				if (distance < best_distance) {
+					best_distance = distance;
+					best_index = p;
+				}
+			}
+			indices |= (uint32_t)best_index << (i * 2);
+		}
+	}
+
+	output[0] = (unsigned char)(color0 & 0xFF);
+	output[1] = (unsigned char)(color0 >> 8);
+	output[2] = (unsigned char)(color1 & 0xFF);
+	output[3] = (unsigned char)(color1 >> 8);
+	std::memcpy(output + 4, &indices, sizeof(indices));
+}
+
+// one channel between the block's minimum and maximum in eight steps, as used by BC4, BC5 and the alpha of BC3
+static void EncodeBc4(const TexelBlock& block, int channel, unsigned char* output) {
+	int min_value = 255;
+	int max_value = 0;
+	for (int i = 0; i < 16; i++) {
+		min_value = std::min(min_value, (int)block.Texels[i][channel]);
+		max_value = std::max(max_value, (int)block.Texels[i][channel]);
+	}
+
+	output[0] = (unsigned char)max_value;
+	output[1] = (unsigned char)min_value;
+
+	uint64_t indices = 0;
+	if (max_value != min_value) {
+		int palette[8];
+		palette[0] = max_value;
+		palette[1] = min_value;
+		for (int p = 2; p < 8; p++) {
+			palette[p] = ((8 - p) * max_value + (p - 1) * min_value) / 7;
+		}
+
+		for (int i = 0; i < 16; i++) {
+			int best_index = 0;
+			int best_distance = 1 << 30;
+			for (int p = 0; p < 8; p++) {
+				int distance = std::abs(block.Texels[i][channel] - palette[p]);
+				if (distance < best_distance) {
+					best_distance = distance;
+					best_index = p;
+				}
+			}
+			indices |= (uint64_t)best_index << (i * 3);
+		}
+	}
+
+	for (int i = 0; i < 6; i++) {
+		output[2 + i] = (unsigned char)(indices >> (i * 8));
+	}
+}
+
+// one level down, averaging 2x2 texels, the last row or column of an odd size is repeated
+static std::vector<unsigned char> Downsample(const std::vector<unsigned char>& rgba, int width, int height, int& next_width, int& next_height) {
+	next_width = std::max(1, width / 2);
+	next_height = std::max(1, height / 2);
+	std::vector<unsigned char> next((size_t)next_width * next_height * 4);
+	for (int y = 0; y < next_height; y++) {
+		int y0 = std::min(y * 2, height - 1);
+		int y1 = std::min(y * 2 + 1, height - 1);
+		for (int x = 0; x < next_width; x++) {
+			int x0 = std::min(x * 2, width - 1);
+			int x1 = std::min(x * 2 + 1, width - 1);
+			for (int c = 0; c < 4; c++) {
+				int sum = rgba[((size_t)y0 * width + x0) * 4 + c] + rgba[((size_t)y0 * width + x1) * 4 + c] +
+					rgba[((size_t)y1 * width + x0) * 4 + c] + rgba[((size_t)y1 * width + x1) * 4 + c];
+				next[((size_t)y * next_width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+	return next;
+}
+
+void TextureCooker::SetEnabled(bool is_enabled) {
+	_is_enabled = is_enabled;
+}
+
+bool TextureCooker::IsEnabled() {
+	return _is_enabled;
+}
+
+TextureImage TextureCooker::Load(const std::string& path, size_t* file_bytes) {
+	uint64_t source_hash = MeshCache::HashFile(path);
+	std::string cooked_path = GetCookedPath(path);
+
+	TextureImage cooked;
+	if (source_hash != 0 && Read(cooked_path, source_hash, cooked, file_bytes)) {
+		return cooked;
+	}
+
+	TextureImage image;
+	MappedFile file;
+	if (file.Open(path)) {
+		image = Texture::Decode(file.GetData(), file.GetSize(), path);
+		if (file_bytes != nullptr) {
+			*file_bytes = file.GetSize();
+		}
+	}
+	else {
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+	}
+	if (image.Data == nullptr) {
+		return image;
+	}
+
+	cooked = Cook(image);
+	Texture::Free(image);
+	Write(cooked_path, cooked, source_hash);
+	return cooked;
+}
+
+TextureImage TextureCooker::Cook(const TextureImage& image) {
+	TextureImage cooked;
+	cooked.Width = image.Width;
+	cooked.Height = image.Height;
+	cooked.Components = image.Components;
+
+	// expanded to RGBA once so every format reads its channels the same way
+	size_t texel_count = (size_t)image.Width * image.Height;
+	std::vector<unsigned char> rgba(texel_count * 4);
+	bool has_alpha = false;
+	for (size_t i = 0; i < texel_count; i++) {
+		const unsigned char* texel = image.Data + i * image.Components;
+		unsigned char* target = rgba.data() + i * 4;
+		target[0] = texel[0];
+		target[1] = image.Components > 1 ? texel[1] : 0;
+		target[2] = image.Components > 2 ? texel[2] : 0;
+		target[3] = image.Components > 3 ? texel[3] : 255;
+		has_alpha |= target[3] != 255;
+	}
+
+	size_t block_bytes = 8;
+	if (image.Components == 1) {
+		cooked.CompressedFormat = GL_COMPRESSED_RED_RGTC1;
+	}
+	else if (image.Components == 2) {
+		cooked.CompressedFormat = GL_COMPRESSED_RG_RGTC2;
+		block_bytes = 16;
+	}
+	else if (has_alpha) {
+		cooked.CompressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		block_bytes = 16;
+	}
+	else {
+		cooked.CompressedFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	}
+
+	int width = image.Width;
+	int height = image.Height;
+	for (;;) {
+		int blocks_x = (width + 3) / 4;
+		int blocks_y = (height + 3) / 4;
+
+		TextureMip mip;
+		mip.Width = width;
+		mip.Height = height;
+		mip.Offset = cooked.CompressedData.size();
+		mip.Size = (size_t)blocks_x * blocks_y * block_bytes;
+		cooked.Mips.push_back(mip);
+		cooked.CompressedData.resize(mip.Offset + mip.Size);
+
+		unsigned char* output = cooked.CompressedData.data() + mip.Offset;
+		for (int block_y = 0; block_y < blocks_y; block_y++) {
+			for (int block_x = 0; block_x < blocks_x; block_x++) {
+				TexelBlock block = ReadBlock(rgba.data(), width, height, block_x, block_y);
+				switch (cooked.CompressedFormat) {
+				case GL_COMPRESSED_RED_RGTC1:
+					EncodeBc4(block, 0, output);
+					break;
+				case GL_COMPRESSED_RG_RGTC2:
+					EncodeBc4(block, 0, output);
+					EncodeBc4(block, 1, output + 8);
+					break;
+				case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+					EncodeBc4(block, 3, output);
+					EncodeBc1(block, output + 8);
+					break;
+				default:
+					EncodeBc1(block, output);
+					break;
+				}
+				output += block_bytes;
+			}
+		}
+
+		if (width == 1 && height == 1) {
+			break;
+		}
+		rgba = Downsample(rgba, width, height, width, height);
+	}
+	return cooked;
+}
+
+bool TextureCooker::Write(const std::string& path, const TextureImage& cooked, uint64_t source_hash) {
+	FileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.Magic, MAGIC, sizeof(MAGIC));
+	header.Version = VERSION;
+	header.Format = cooked.CompressedFormat;
+	header.Width = (uint32_t)cooked.Width;
+	header.Height = (uint32_t)cooked.Height;
+	header.Components = (uint32_t)cooked.Components;
+	header.MipCount = (uint32_t)cooked.Mips.size();
+	header.SourceHash = source_hash;
+
+	size_t data_offset = sizeof(header) + cooked.Mips.size() * sizeof(MipRecord);
+	data_offset = (data_offset + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+	std::vector<unsigned char> file(data_offset + cooked.CompressedData.size());
+	std::memcpy(file.data(), &header, sizeof(header));
+	for (size_t i = 0; i < cooked.Mips.size(); i++) {
+		MipRecord record = MipRecord();
+		record.Width = (uint32_t)cooked.Mips[i].Width;
+		record.Height = (uint32_t)cooked.Mips[i].Height;
+		record.Offset = data_offset + cooked.Mips[i].Offset;
+		record.Size = cooked.Mips[i].Size;
+		std::memcpy(file.data() + sizeof(header) + i * sizeof(MipRecord), &record, sizeof(record));
+	}
+	std::memcpy(file.data() + data_offset, cooked.CompressedData.data(), cooked.CompressedData.size());
+
+	// written next to the old file and moved over it, so a crash never leaves a half written texture behind.
+	// Two models sharing a texture may cook it at once, so every writer gets its own temporary file.
+	static std::atomic<unsigned int> temporary_count(0);
+	std::string temporary_path = path + "." + std::to_string(temporary_count++) + ".tmp";
+	{
+		std::ofstream stream(temporary_path, std::ios::binary | std::ios::trunc);
+		if (!stream.write((const char*)file.data(), file.size())) {
+			std::cout << "TEXTURE COOK " << path << ": could not be written" << std::endl;
+			return false;
+		}
+	}
+	std::remove(path.c_str());
+	if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+		std::remove(temporary_path.c_str());
+		// another writer put its copy there first, the same texture cooked from the same source
+		if (std::ifstream(path, std::ios::binary).is_open()) {
+			return true;
+		}
+		std::cout << "TEXTURE COOK " << path << ": could not be written" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool TextureCooker::Read(const std::string& path, uint64_t source_hash, TextureImage& cooked, size_t* file_bytes) {
+	MappedFile file;
+	if (!file.Open(path)) {
+		return false;
+	}
+
+	FileHeader header;
+	if (file.GetSize() < sizeof(header)) {
+		return false;
+	}
+	std::memcpy(&header, file.GetData(), sizeof(header));
+	if (std::memcmp(header.Magic, MAGIC, sizeof(MAGIC)) != 0 || header.Version != VERSION || header.SourceHash != source_hash ||
+		header.MipCount == 0 || file.GetSize() < sizeof(header) + (uint64_t)header.MipCount * sizeof(MipRecord)) {
+		std::cout << "TEXTURE COOK " << path << ": stale, cooking again" << std::endl;
+		return false;
+	}
+
+	// the levels are stored back to back, copied out in one go
+	std::vector<MipRecord> records(header.MipCount);
+	std::memcpy(records.data(), file.GetData() + sizeof(header), records.size() * sizeof(MipRecord));
+	uint64_t data_offset = records[0].Offset;
+	uint64_t data_end = records.back().Offset + records.back().Size;
+	if (data_end > file.GetSize() || data_offset > data_end) {
+		std::cout << "TEXTURE COOK " << path << ": truncated, cooking again" << std::endl;
+		return false;
+	}
+
+	cooked.Width = (int)header.Width;
+	cooked.Height = (int)header.Height;
+	cooked.Components = (int)header.Components;
+	cooked.CompressedFormat = header.Format;
+	cooked.CompressedData.assign(file.GetData() + data_offset, file.GetData() + data_end);
+	cooked.Mips.resize(records.size());
+	for (size_t i = 0; i < records.size(); i++) {
+		if (records[i].Offset < data_offset || records[i].Offset + records[i].Size > data_end) {
+			Texture::Free(cooked);
+			return false;
+		}
+		cooked.Mips[i].Width = (int)records[i].Width;
+		cooked.Mips[i].Height = (int)records[i].Height;
+		cooked.Mips[i].Offset = (size_t)(records[i].Offset - data_offset);
+		cooked.Mips[i].Size = (size_t)records[i].Size;
+	}
+
+	if (file_bytes != nullptr) {
+		*file_bytes = file.GetSize();
+	}
+	return true;
+}
+
+std::string TextureCooker::GetCookedPath(const std::string& source_path) {
+	return source_path + ".logltex";
+}
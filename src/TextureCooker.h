@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "Texture.h"
+
+// Block compresses textures offline and caches them next to their source, e.g. lion.png.logltex, so later loads
+// skip decoding the source and upload a few times fewer bytes with glCompressedTexImage2D.
+//
+// Formats: BC4 for one channel, BC5 for two, BC1 for RGB and opaque RGBA, BC3 when any alpha is below 255. The
+// full mip chain is box filtered and encoded once, so nothing calls glGenerateMipmap on these textures.
+//
+// Layout: FileHeader, one MipRecord per level, then the blocks of each level. A file is only used when its version
+// and the hash of the source file match, otherwise it is cooked again.
+class TextureCooker {
+public:
+	static const uint32_t VERSION = 1;
+
+	// off until the GL context reports S3TC support
+	static void SetEnabled(bool is_enabled);
+	static bool IsEnabled();
+
+	// the cooked image of a source file, cooking and writing it first when there is no valid one.
+	// Falls back to the plain decode when the source cannot be read. file_bytes is what was read from disk.
+	static TextureImage Load(const std::string& path, size_t* file_bytes = nullptr);
+	// block compresses a decoded image with its mip chain, the image itself is left as it is
+	static TextureImage Cook(const TextureImage& image);
+	static bool Write(const std::string& path, const TextureImage& cooked, uint64_t source_hash);
+	// false when missing, truncated or stale
+	static bool Read(const std::string& path, uint64_t source_hash, TextureImage& cooked, size_t* file_bytes = nullptr);
+
+	static std::string GetCookedPath(const std::string& source_path);
+
+private:
+	struct FileHeader {
+		char Magic[8];
+		uint32_t Version;
+		uint32_t Format;
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Components;
+		uint32_t MipCount;
+		uint64_t SourceHash;
+	};
+
+	struct MipRecord {
+		uint32_t Width;
+		uint32_t Height;
+		uint64_t Offset;
+		uint64_t Size;
+	};
+
+	static std::atomic<bool> _is_enabled;
+};
@@ -0,0 +1,104 @@
+#include "TextureDecodeBatch.h"
+
+#include <algorithm>
+
+#include "MappedFile.h"
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+
+TextureDecodeBatch::TextureDecodeBatch() : _state(std::make_shared<SharedState>()), _pending_count(0), _taken_count(0),
+	_file_bytes(0), _image_bytes(0), _decode_milliseconds(0.0) {
+}
+
+TextureDecodeBatch::~TextureDecodeBatch() {
+	std::lock_guard<std::mutex> lock(_state->Mutex);
+	_state->IsAbandoned = true;
+	for (DecodedTexture& decoded : _state->Done) {
+		Texture::Free(decoded.Image);
+	}
+	_state->Done.clear();
+}
+
+void TextureDecodeBatch::Add(size_t index, const std::string& path) {
+	if (_pending_count == 0 && _taken_count == 0) {
+		_start = std::chrono::steady_clock::now();
+	}
+	_pending_count++;
+
+	std::shared_ptr<SharedState> state = _state;
+	ThreadPool::GetShared().Submit([state, index, path]() {
+		DecodedTexture decoded;
+		decoded.Index = index;
+		decoded.Path = path;
+
+		// read through a mapping so the file size is known and the IO is part of the timing
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		MappedFile file;
+		if (TextureCooker::IsEnabled()) {
+			decoded.Image = TextureCooker::Load(path, &decoded.FileBytes);
+		}
+		else if (file.Open(path)) {
+			decoded.FileBytes = file.GetSize();
+			decoded.Image = Texture::Decode(file.GetData(), file.GetSize(), path);
+		}
+		else {
+			decoded.Image = Texture::Decode(path);
+		}
+		decoded.DecodeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(state->Mutex);
+		if (state->IsAbandoned) {
+			Texture::Free(decoded.Image);
+			return;
+		}
+		state->Done.push_back(std::move(decoded));
+		state->Finished.notify_one();
+	});
+}
+
+bool TextureDecodeBatch::Next(DecodedTexture& decoded, bool wait) {
+	if (_pending_count == 0) {
+		return false;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(_state->Mutex);
+		if (wait) {
+			_state->Finished.wait(lock, [this]() { return !_state->Done.empty(); });
+		}
+		else if (_state->Done.empty()) {
+			return false;
+		}
+		decoded = std::move(_state->Done.front());
+		_state->Done.pop_front();
+	}
+
+	_pending_count--;
+	_taken_count++;
+	_file_bytes += decoded.FileBytes;
+	if (decoded.Image.CompressedFormat != 0) {
+		_image_bytes += decoded.Image.CompressedData.size();
+	}
+	else {
+		_image_bytes += (size_t)decoded.Image.Width * decoded.Image.Height * decoded.Image.Components;
+	}
+	_decode_milliseconds += decoded.DecodeMilliseconds;
+	_last_finish = std::chrono::steady_clock::now();
+	return true;
+}
+
+size_t TextureDecodeBatch::GetPendingCount() const {
+	return _pending_count;
+}
+
+void TextureDecodeBatch::PrintReport(const std::string& label) const {
+	if (_taken_count == 0) {
+		return;
+	}
+
+	double wall_milliseconds = std::chrono::duration<double, std::milli>(_last_finish - _start).count();
+	double seconds = std::max(wall_milliseconds, 0.001) / 1000.0;
+	std::cout << "TEXTURE DECODE " << label << ": " << _taken_count << " images, " << _file_bytes / (1024.0 * 1024.0) << " MB files to "
+		<< _image_bytes / (1024.0 * 1024.0) << " MB to upload in " << wall_milliseconds << " ms (" << _decode_milliseconds << " ms of decoding), "
+		<< _file_bytes / (1024.0 * 1024.0) / seconds << " MB/s files, " << _image_bytes / (1024.0 * 1024.0) / seconds << " MB/s to upload" << std::endl;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "Texture.h"
+
+// an image of a TextureDecodeBatch, with what decoding it cost
+struct DecodedTexture {
+	size_t Index = 0;
+	std::string Path;
+	TextureImage Image;
+	size_t FileBytes = 0;
+	double DecodeMilliseconds = 0.0;
+};
+
+// Decodes image files on the shared thread pool, stb_image keeps no state between calls. The GL thread takes the
+// images in the order they finish with Next and uploads them while the rest are still decoding.
+class TextureDecodeBatch {
+public:
+	TextureDecodeBatch();
+	TextureDecodeBatch(const TextureDecodeBatch&) = delete;
+	TextureDecodeBatch& operator=(const TextureDecodeBatch&) = delete;
+	// images not taken yet are freed once their decode finishes
+	~TextureDecodeBatch();
+
+	// starts decoding a file, the index is handed back with its image
+	void Add(size_t index, const std::string& path);
+	// the next finished image, false when none is ready without waiting or every image was taken
+	bool Next(DecodedTexture& decoded, bool wait);
+	// added but not taken yet
+	size_t GetPendingCount() const;
+
+	// file and pixel throughput of everything taken so far, over the wall time since the first Add
+	void PrintReport(const std::string& label) const;
+
+private:
+	struct SharedState {
+		std::mutex Mutex;
+		std::condition_variable Finished;
+		std::deque<DecodedTexture> Done;
+		bool IsAbandoned = false;
+	};
+
+	std::shared_ptr<SharedState> _state;
+	size_t _pending_count;
+	size_t _taken_count;
+	size_t _file_bytes;
+	size_t _image_bytes;
+	double _decode_milliseconds;
+	std::chrono::steady_clock::time_point _start;
+	std::chrono::steady_clock::time_point _last_finish;
+};
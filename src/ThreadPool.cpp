@@ -0,0 +1,120 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int worker_count) : _is_stopping(false) {
+	if (worker_count == 0) {
+		unsigned int hardware_threads = std::thread::hardware_concurrency();
+		worker_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+	}
+
+	_workers.reserve(worker_count);
+	for (unsigned int i = 0; i < worker_count; i++) {
+		_workers.emplace_back(&ThreadPool::RunWorker, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_is_stopping = true;
+	}
+	_job_available.notify_all();
+
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::Submit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_jobs.push_back(std::move(job));
+	}
+	_job_available.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& body, unsigned int max_threads) {
+	if (count == 0) {
+		return;
+	}
+
+	unsigned int thread_count = GetThreadCount();
+	if (max_threads > 0 && max_threads < thread_count) {
+		thread_count = max_threads;
+	}
+	if (thread_count > count) {
+		thread_count = (unsigned int)count;
+	}
+
+	// shared with the helpers, one that only starts after the caller is done finds it closed and leaves without
+	// touching body. The caller never waits for a helper that has not started, so ParallelFor can run inside a job
+	// even when every worker is busy.
+	struct SharedState {
+		std::atomic<size_t> NextIndex;
+		std::mutex Mutex;
+		std::condition_variable HelpersDone;
+		unsigned int RunningHelpers;
+		bool IsClosed;
+	};
+	std::shared_ptr<SharedState> state = std::make_shared<SharedState>();
+	state->NextIndex = 0;
+	state->RunningHelpers = 0;
+	state->IsClosed = false;
+
+	const std::function<void(size_t)>* shared_body = &body;
+	auto run = [state, shared_body, count]() {
+		for (size_t i = state->NextIndex++; i < count; i = state->NextIndex++) {
+			(*shared_body)(i);
+		}
+	};
+
+	for (unsigned int i = 0; i + 1 < thread_count; i++) {
+		Submit([state, run]() {
+			{
+				std::lock_guard<std::mutex> lock(state->Mutex);
+				if (state->IsClosed) {
+					return;
+				}
+				state->RunningHelpers++;
+			}
+			run();
+			std::lock_guard<std::mutex> lock(state->Mutex);
+			if (--state->RunningHelpers == 0) {
+				state->HelpersDone.notify_one();
+			}
+		});
+	}
+
+	run();
+
+	std::unique_lock<std::mutex> lock(state->Mutex);
+	state->IsClosed = true;
+	state->HelpersDone.wait(lock, [&]() { return state->RunningHelpers == 0; });
+}
+
+unsigned int ThreadPool::GetThreadCount() const {
+	return (unsigned int)_workers.size() + 1;
+}
+
+ThreadPool& ThreadPool::GetShared() {
+	static ThreadPool shared_pool;
+	return shared_pool;
+}
+
+void ThreadPool::RunWorker() {
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_job_available.wait(lock, [this]() { return _is_stopping || !_jobs.empty(); });
+			if (_jobs.empty()) {
+				return;
+			}
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+		}
+		job();
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued jobs. Jobs must not touch GL, the context belongs to the main thread.
+class ThreadPool {
+public:
+	// 0 workers means one per hardware thread besides the caller's
+	explicit ThreadPool(unsigned int worker_count = 0);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	// finishes the queued jobs, then joins
+	~ThreadPool();
+
+	void Submit(std::function<void()> job);
+
+	// runs body(i) for every i below count on up to max_threads threads, the caller included (0 for all of them),
+	// and returns once every call has finished. Indices are handed out one at a time, so uneven work still balances.
+	// Safe to call from inside a job, the caller does all the work itself if no worker is free.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& body, unsigned int max_threads = 0);
+
+	// workers plus the calling thread
+	unsigned int GetThreadCount() const;
+
+	// pool shared by loading code, created on first use
+	static ThreadPool& GetShared();
+
+private:
+	std::vector<std::thread> _workers;
+	std::deque<std::function<void()>> _jobs;
+	std::mutex _mutex;
+	std::condition_variable _job_available;
+	bool _is_stopping;
+
+	void RunWorker();
+};
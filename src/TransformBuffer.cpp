@@ -0,0 +1,61 @@
+#include "TransformBuffer.h"
+
+#include <algorithm>
+
+TransformBuffer::TransformBuffer() : _ubo(0), _stride(sizeof(ObjectTransform)), _capacity(1), _count(0) {
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0) {
+		_stride = (sizeof(ObjectTransform) + alignment - 1) / alignment * alignment;
+	}
+
+	glGenBuffers(1, &_ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+	glBufferData(GL_UNIFORM_BUFFER, _capacity * _stride, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+TransformBuffer::~TransformBuffer() {
+	glDeleteBuffers(1, &_ubo);
+}
+
+void TransformBuffer::Upload(const glm::mat4* model_matrices, size_t count, const glm::mat4& view_projection) {
+	_data.resize(std::max((size_t)1, count) * _stride);
+
+	// one pass over contiguous matrices, the normal matrix inverse runs once per object instead of once per vertex
+	for (size_t i = 0; i < count; i++) {
+		ObjectTransform* transform = (ObjectTransform*)(_data.data() + i * _stride);
+		transform->Model = model_matrices[i];
+		glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(model_matrices[i])));
+		for (int column = 0; column < 3; column++) {
+			transform->Normal[column] = glm::vec4(normal[column], 0.0f);
+		}
+		transform->ModelViewProjection = view_projection * model_matrices[i];
+	}
+	_count = count;
+
+	_capacity = std::max(_capacity, count);
+	glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+	glBufferData(GL_UNIFORM_BUFFER, _capacity * _stride, NULL, GL_STREAM_DRAW);
+	if (count > 0) {
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, count * _stride, _data.data());
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void TransformBuffer::Upload(const std::vector<glm::mat4>& model_matrices, const glm::mat4& view_projection) {
+	Upload(model_matrices.data(), model_matrices.size(), view_projection);
+}
+
+void TransformBuffer::Bind(size_t index) const {
+	glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, _ubo, index * _stride, sizeof(ObjectTransform));
+}
+
+void TransformBuffer::Set(const glm::mat4& model_matrix, const glm::mat4& view_projection) {
+	Upload(&model_matrix, 1, view_projection);
+	Bind(0);
+}
+
+size_t TransformBuffer::GetCount() const {
+	return _count;
+}
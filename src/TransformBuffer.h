@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Per object matrices for the ObjectTransform uniform block of the vertex shaders: model, normal and
+// model-view-projection. They are computed for all objects of a pass in one loop and uploaded in one go,
+// so shaders never invert a matrix per vertex. Each object gets its own aligned slice of one uniform
+// buffer, selected with glBindBufferRange before its draw.
+// Destroying it deletes the uniform buffer, which needs the context still current.
+class TransformBuffer {
+public:
+	// uniform buffer binding point every program's ObjectTransform block is assigned to
+	static const GLuint BINDING = 0;
+
+	TransformBuffer();
+	TransformBuffer(const TransformBuffer&) = delete;
+	TransformBuffer& operator=(const TransformBuffer&) = delete;
+	~TransformBuffer();
+
+	// replaces the blocks with those of the given objects, the previous contents are orphaned so draws
+	// still in flight keep theirs
+	void Upload(const glm::mat4* model_matrices, size_t count, const glm::mat4& view_projection);
+	void Upload(const std::vector<glm::mat4>& model_matrices, const glm::mat4& view_projection);
+	// makes the block of one uploaded object the one shaders read
+	void Bind(size_t index) const;
+	// uploads and binds a single object, for one-off draws
+	void Set(const glm::mat4& model_matrix, const glm::mat4& view_projection);
+	size_t GetCount() const;
+
+private:
+	// std140 layout of the block, a mat3 takes three vec4 columns
+	struct ObjectTransform {
+		glm::mat4 Model;
+		glm::vec4 Normal[3];
+		glm::mat4 ModelViewProjection;
+	};
+
+	unsigned int _ubo;
+	// bytes between two blocks, sizeof(ObjectTransform) rounded up to the uniform buffer offset alignment
+	size_t _stride;
+	size_t _capacity;
+	size_t _count;
+	// reused between uploads so streaming does not allocate
+	std::vector<unsigned char> _data;
+};
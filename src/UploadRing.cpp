@@ -0,0 +1,319 @@
+#include "UploadRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "ThreadPool.h"
+
+// copies are placed at this alignment in a segment, enough for any pixel or index type
+static const size_t STAGING_ALIGNMENT = 16;
+
+UploadRing::UploadRing(size_t segment_bytes, unsigned int segment_count)
+	: _segment_bytes(segment_bytes), _next_segment(0), _filling_segment(NO_SEGMENT), _last_ticket(0), _issued_ticket(0),
+	_queued_bytes(0), _staged_bytes(0), _total_staged_bytes(0) {
+	_segments.resize(std::max(segment_count, 2u));
+	for (Segment& segment : _segments) {
+		glGenBuffers(1, &segment.Buffer);
+		glBindBuffer(GL_COPY_READ_BUFFER, segment.Buffer);
+		glBufferData(GL_COPY_READ_BUFFER, _segment_bytes, NULL, GL_STREAM_DRAW);
+		segment.Fence = 0;
+		segment.Mapping = nullptr;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+UploadRing::~UploadRing() {
+	// the worker writes into the mapping, it has to be done before the buffer goes
+	WaitForFill();
+
+	for (Segment& segment : _segments) {
+		if (segment.Mapping != nullptr) {
+			glBindBuffer(GL_COPY_READ_BUFFER, segment.Buffer);
+			glUnmapBuffer(GL_COPY_READ_BUFFER);
+		}
+		if (segment.Fence != 0) {
+			glDeleteSync(segment.Fence);
+		}
+		glDeleteBuffers(1, &segment.Buffer);
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+uint64_t UploadRing::QueueBuffer(unsigned int buffer, size_t offset, const void* data, size_t size) {
+	Upload upload = {};
+	upload.Buffer = buffer;
+	upload.Offset = offset;
+	upload.Data = (const unsigned char*)data;
+	upload.Size = size;
+	return Enqueue(upload);
+}
+
+uint64_t UploadRing::QueueBuffer(const unsigned int* buffer, size_t offset, const void* data, size_t size) {
+	Upload upload = {};
+	upload.BufferSource = buffer;
+	upload.Offset = offset;
+	upload.Data = (const unsigned char*)data;
+	upload.Size = size;
+	return Enqueue(upload);
+}
+
+uint64_t UploadRing::QueueTexture(unsigned int texture, int level, GLenum format, bool is_compressed, int width, int height,
+	const void* data, size_t size, bool generate_mipmap) {
+	Upload upload = {};
+	upload.IsTexture = true;
+	upload.Texture = texture;
+	upload.Level = level;
+	upload.Format = format;
+	upload.IsCompressed = is_compressed;
+	upload.GenerateMipmap = generate_mipmap;
+	upload.Width = width;
+	upload.Height = height;
+	upload.RowHeight = is_compressed ? 4 : 1;
+	int row_count = (height + upload.RowHeight - 1) / upload.RowHeight;
+	upload.RowBytes = row_count > 0 ? size / row_count : 0;
+	upload.Data = (const unsigned char*)data;
+	upload.Size = size;
+	return Enqueue(upload);
+}
+
+uint64_t UploadRing::Enqueue(Upload upload) {
+	if (upload.Size == 0) {
+		return _last_ticket;
+	}
+	// a segment takes at least one whole row
+	if (upload.IsTexture && upload.RowBytes > _segment_bytes) {
+		std::cout << "ERROR::UPLOAD_RING::ROW_LARGER_THAN_SEGMENT: " << upload.RowBytes << " bytes" << std::endl;
+		return _last_ticket;
+	}
+
+	upload.Ticket = ++_last_ticket;
+	_queued_bytes += upload.Size;
+	_queue.push_back(upload);
+	return upload.Ticket;
+}
+
+void UploadRing::Update(size_t byte_budget) {
+	_staged_bytes = 0;
+
+	// the fill started last frame has had a frame to finish, the main thread never waits for it here
+	if (_filling_segment != NO_SEGMENT && _segments[_filling_segment].IsFilled->load()) {
+		IssueFilled();
+	}
+	RetireSegments(false);
+	if (_filling_segment == NO_SEGMENT) {
+		StartFill(byte_budget);
+	}
+}
+
+void UploadRing::Flush() {
+	while (!_queue.empty() || _filling_segment != NO_SEGMENT) {
+		if (_filling_segment != NO_SEGMENT) {
+			WaitForFill();
+			IssueFilled();
+		}
+		RetireSegments(_in_flight.size() == _segments.size());
+		StartFill(_segment_bytes);
+	}
+}
+
+bool UploadRing::IsIssued(uint64_t ticket) const {
+	return ticket <= _issued_ticket;
+}
+
+uint64_t UploadRing::GetLastTicket() const {
+	return _last_ticket;
+}
+
+size_t UploadRing::GetQueuedBytes() const {
+	return _queued_bytes;
+}
+
+size_t UploadRing::GetStagedBytes() const {
+	return _staged_bytes;
+}
+
+size_t UploadRing::GetTotalStagedBytes() const {
+	return _total_staged_bytes;
+}
+
+unsigned int UploadRing::GetSegmentsInUse() const {
+	return (unsigned int)_in_flight.size() + (_filling_segment != NO_SEGMENT ? 1 : 0);
+}
+
+size_t UploadRing::GetSegmentBytes() const {
+	return _segment_bytes;
+}
+
+void UploadRing::IssueFilled() {
+	Segment& segment = _segments[_filling_segment];
+	glBindBuffer(GL_COPY_READ_BUFFER, segment.Buffer);
+	if (segment.Mapping != nullptr && glUnmapBuffer(GL_COPY_READ_BUFFER) == GL_FALSE) {
+		// the contents are undefined after a lost mapping, rare enough to only report
+		std::cout << "ERROR::UPLOAD_RING::STAGING_LOST" << std::endl;
+	}
+	segment.Mapping = nullptr;
+
+	// rows are tightly packed in the segment
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, segment.Buffer);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (const Copy& copy : segment.Copies) {
+		const Upload& source = copy.Source;
+		if (source.IsTexture) {
+			int y = (int)(copy.SourceOffset / source.RowBytes) * source.RowHeight;
+			int height = std::min((int)(copy.Size / source.RowBytes) * source.RowHeight, source.Height - y);
+			const void* offset = (const void*)copy.StagingOffset;
+
+			glBindTexture(GL_TEXTURE_2D, source.Texture);
+			if (source.IsCompressed) {
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, source.Level, 0, y, source.Width, height, source.Format, (GLsizei)copy.Size, offset);
+			}
+			else {
+				glTexSubImage2D(GL_TEXTURE_2D, source.Level, 0, y, source.Width, height, source.Format, GL_UNSIGNED_BYTE, offset);
+			}
+			if (copy.IsLast && source.GenerateMipmap) {
+				glGenerateMipmap(GL_TEXTURE_2D);
+			}
+		}
+		else {
+			unsigned int buffer = source.BufferSource != nullptr ? *source.BufferSource : source.Buffer;
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, copy.StagingOffset, source.Offset + copy.SourceOffset, copy.Size);
+		}
+
+		if (copy.IsLast) {
+			_issued_ticket = source.Ticket;
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	segment.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	segment.Copies.clear();
+	_in_flight.push_back(_filling_segment);
+	_filling_segment = NO_SEGMENT;
+}
+
+void UploadRing::RetireSegments(bool wait) {
+	while (!_in_flight.empty()) {
+		Segment& segment = _segments[_in_flight.front()];
+		// the oldest copies finish first, so the first unsignalled fence ends the scan
+		GLuint64 timeout = wait ? 1000000000 : 0;
+		GLenum result = glClientWaitSync(segment.Fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			if (wait) {
+				continue;
+			}
+			return;
+		}
+		if (result == GL_WAIT_FAILED) {
+			// the fence can never signal, the segment is reused rather than kept in flight for good, which would leave
+			// Flush looping with no segment to fill
+			std::cout << "ERROR::UPLOAD_RING::WAIT_FAILED" << std::endl;
+		}
+
+		glDeleteSync(segment.Fence);
+		segment.Fence = 0;
+		_in_flight.pop_front();
+		// only one is needed to make room
+		wait = false;
+	}
+}
+
+void UploadRing::StartFill(size_t byte_budget) {
+	if (_queue.empty() || _in_flight.size() == _segments.size()) {
+		return;
+	}
+
+	size_t index = _next_segment;
+	Segment& segment = _segments[index];
+	size_t budget = std::min(std::max(byte_budget, (size_t)1), _segment_bytes);
+
+	size_t used = 0;
+	while (!_queue.empty() && used < budget) {
+		Upload& upload = _queue.front();
+		size_t available = budget - used;
+		size_t size = std::min(available, upload.Size - upload.Staged);
+
+		if (upload.IsTexture) {
+			// whole rows only, a row larger than the budget goes alone
+			size_t rows = size / upload.RowBytes;
+			if (rows == 0) {
+				if (used > 0) {
+					break;
+				}
+				rows = 1;
+			}
+			size = rows * upload.RowBytes;
+		}
+
+		Copy copy;
+		copy.Source = upload;
+		copy.StagingOffset = used;
+		copy.SourceOffset = upload.Staged;
+		copy.Size = size;
+		upload.Staged += size;
+		copy.IsLast = upload.Staged == upload.Size;
+		segment.Copies.push_back(copy);
+
+		used = (used + size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+		if (copy.IsLast) {
+			_queue.pop_front();
+		}
+	}
+
+	// the fence retired whatever read this segment before, unsynchronized keeps the driver from checking again
+	glBindBuffer(GL_COPY_READ_BUFFER, segment.Buffer);
+	segment.Mapping = (unsigned char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, _segment_bytes,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (segment.Mapping == nullptr) {
+		// fill it the slow way on this thread rather than lose the data
+		for (const Copy& copy : segment.Copies) {
+			glBufferSubData(GL_COPY_READ_BUFFER, copy.StagingOffset, copy.Size, copy.Source.Data + copy.SourceOffset);
+		}
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	size_t staged = 0;
+	for (const Copy& copy : segment.Copies) {
+		staged += copy.Size;
+	}
+	_queued_bytes -= staged;
+	_staged_bytes += staged;
+	_total_staged_bytes += staged;
+
+	segment.IsFilled = std::make_shared<std::atomic<bool>>(false);
+	if (segment.Mapping == nullptr) {
+		segment.IsFilled->store(true);
+	}
+	else {
+		std::shared_ptr<std::atomic<bool>> is_filled = segment.IsFilled;
+		unsigned char* mapping = segment.Mapping;
+		std::vector<Copy> copies = segment.Copies;
+		ThreadPool::GetShared().Submit([is_filled, mapping, copies]() {
+			for (const Copy& copy : copies) {
+				std::memcpy(mapping + copy.StagingOffset, copy.Source.Data + copy.SourceOffset, copy.Size);
+			}
+			is_filled->store(true);
+		});
+	}
+
+	_filling_segment = index;
+	_next_segment = (index + 1) % _segments.size();
+}
+
+void UploadRing::WaitForFill() const {
+	if (_filling_segment == NO_SEGMENT) {
+		return;
+	}
+	const Segment& segment = _segments[_filling_segment];
+	while (!segment.IsFilled->load()) {
+		std::this_thread::yield();
+	}
+}
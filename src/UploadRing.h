@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Streams buffer and texture data to the GPU through a ring of staging buffers instead of handing it to
+// glBufferData / glTexImage2D, which copy everything before returning and stall the frame a model arrives in.
+//
+// Every Update issues the GPU copies out of the segment filled since the last one, fences them, and has a worker
+// memcpy the next part of the queue into a free segment, at most byte_budget bytes of it. Segments are reused once
+// their fence has signalled. Buffers are split by byte ranges and textures by rows, so no single frame copies
+// more than the budget however large the queued upload is. Everything happens in queue order.
+class UploadRing {
+public:
+	UploadRing(size_t segment_bytes, unsigned int segment_count);
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+	// waits for a fill in progress, whatever is still queued is dropped, needs the context current
+	~UploadRing();
+
+	// the data has to stay valid until IsIssued returns true for the returned ticket
+	uint64_t QueueBuffer(unsigned int buffer, size_t offset, const void* data, size_t size);
+	// the buffer name is read when the copy is issued, for buffers that are replaced as they grow
+	uint64_t QueueBuffer(const unsigned int* buffer, size_t offset, const void* data, size_t size);
+	// one whole level of a texture already allocated with glTexImage2D or glCompressedTexImage2D, format is the
+	// pixel format of uncompressed data (bytes per channel) or the internal format of compressed data (4x4 blocks).
+	// generate_mipmap builds the other levels from this one once all of it is in.
+	uint64_t QueueTexture(unsigned int texture, int level, GLenum format, bool is_compressed, int width, int height,
+		const void* data, size_t size, bool generate_mipmap);
+
+	// once per frame on the GL thread
+	void Update(size_t byte_budget);
+	// issues everything queued, waiting on fills and fences as needed, for loads outside the frame loop
+	void Flush();
+
+	bool IsIssued(uint64_t ticket) const;
+	// ticket of the last upload queued, 0 before any
+	uint64_t GetLastTicket() const;
+	size_t GetQueuedBytes() const;
+	// bytes staged by the last Update
+	size_t GetStagedBytes() const;
+	size_t GetTotalStagedBytes() const;
+	unsigned int GetSegmentsInUse() const;
+	size_t GetSegmentBytes() const;
+
+private:
+	struct Upload {
+		uint64_t Ticket;
+		bool IsTexture;
+		unsigned int Buffer;
+		const unsigned int* BufferSource;
+		size_t Offset;
+		unsigned int Texture;
+		int Level;
+		GLenum Format;
+		bool IsCompressed;
+		bool GenerateMipmap;
+		int Width;
+		int Height;
+		// bytes per row of texels, or per row of blocks when compressed
+		size_t RowBytes;
+		int RowHeight;
+		const unsigned char* Data;
+		size_t Size;
+		// bytes handed to segments so far
+		size_t Staged;
+	};
+
+	// the part of an upload staged in a segment
+	struct Copy {
+		Upload Source;
+		size_t StagingOffset;
+		size_t SourceOffset;
+		size_t Size;
+		bool IsLast;
+	};
+
+	struct Segment {
+		unsigned int Buffer;
+		GLsync Fence;
+		unsigned char* Mapping;
+		std::vector<Copy> Copies;
+		// set by the worker once the copies are in the mapping
+		std::shared_ptr<std::atomic<bool>> IsFilled;
+	};
+
+	static const size_t NO_SEGMENT = (size_t)-1;
+
+	size_t _segment_bytes;
+	std::vector<Segment> _segments;
+	// segments are used in ring order: in flight ones behind the filling one, free ones ahead of it
+	size_t _next_segment;
+	size_t _filling_segment;
+	std::deque<size_t> _in_flight;
+	std::deque<Upload> _queue;
+	uint64_t _last_ticket;
+	uint64_t _issued_ticket;
+	size_t _queued_bytes;
+	size_t _staged_bytes;
+	size_t _total_staged_bytes;
+
+	uint64_t Enqueue(Upload upload);
+	// unmaps the filled segment and issues its copies
+	void IssueFilled();
+	void RetireSegments(bool wait);
+	void StartFill(size_t byte_budget);
+	void WaitForFill() const;
+};
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "Vertex.h"
+
+// Vertex formats a mesh can be uploaded with. Each one maps to a VertexLayout below.
+enum class VertexFormat {
+	// 32 bytes: float position, float normal, float texture coordinates
+	Full,
+	// 16 bytes: half float position, octahedral normal, half float texture coordinates
+	HalfFloat,
+	// 16 bytes: 16 bit position normalized to the mesh bounds, octahedral normal, half float texture coordinates
+	Quantized
+};
+
+// How the vertex shader gets the object space position back: position * scale + offset
+struct VertexQuantization {
+	glm::vec3 PositionOffset = glm::vec3(0.0f);
+	glm::vec3 PositionScale = glm::vec3(1.0f);
+};
+
+// flat axes would divide by zero, they keep a scale of 1
+inline glm::vec3 SafeQuantizationScale(glm::vec3 scale) {
+	for (int i = 0; i < 3; i++) {
+		if (scale[i] <= 0.0f) {
+			scale[i] = 1.0f;
+		}
+	}
+	return scale;
+}
+
+// Octahedral mapping of a unit vector onto [-1, 1]^2
+inline glm::vec2 EncodeOctahedral(glm::vec3 n) {
+	n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	glm::vec2 encoded(n.x, n.y);
+	if (n.z < 0.0f) {
+		encoded.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		encoded.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return encoded;
+}
+
+// Attribute encodings. Each one knows its GL description and how to write itself from a Vertex.
+
+struct Float3Position {
+	static const GLint Components = 3;
+	static const GLenum Type = GL_FLOAT;
+	static const GLboolean Normalized = GL_FALSE;
+	static const unsigned int Size = 3 * sizeof(float);
+
+	static VertexQuantization ComputeQuantization(glm::vec3, glm::vec3) {
+		return VertexQuantization();
+	}
+
+	static void Pack(const Vertex& vertex, const VertexQuantization&, unsigned char* out) {
+		std::memcpy(out, &vertex.Position, Size);
+	}
+};
+
+struct Half4Position {
+	static const GLint Components = 4;
+	static const GLenum Type = GL_HALF_FLOAT;
+	static const GLboolean Normalized = GL_FALSE;
+	static const unsigned int Size = 4 * sizeof(unsigned short);
+
+	// centered on the bounds so the whole [-1, 1] half float range is used
+	static VertexQuantization ComputeQuantization(glm::vec3 bounds_min, glm::vec3 bounds_max) {
+		VertexQuantization quantization;
+		quantization.PositionOffset = (bounds_min + bounds_max) * 0.5f;
+		quantization.PositionScale = SafeQuantizationScale((bounds_max - bounds_min) * 0.5f);
+		return quantization;
+	}
+
+	static void Pack(const Vertex& vertex, const VertexQuantization& quantization, unsigned char* out) {
+		glm::vec3 normalized = (vertex.Position - quantization.PositionOffset) / quantization.PositionScale;
+		unsigned short packed[4] = {
+			glm::packHalf1x16(normalized.x),
+			glm::packHalf1x16(normalized.y),
+			glm::packHalf1x16(normalized.z),
+			glm::packHalf1x16(1.0f)
+		};
+		std::memcpy(out, packed, Size);
+	}
+};
+
+struct Unorm16Position {
+	static const GLint Components = 4;
+	static const GLenum Type = GL_UNSIGNED_SHORT;
+	static const GLboolean Normalized = GL_TRUE;
+	static const unsigned int Size = 4 * sizeof(unsigned short);
+
+	static VertexQuantization ComputeQuantization(glm::vec3 bounds_min, glm::vec3 bounds_max) {
+		VertexQuantization quantization;
+		quantization.PositionOffset = bounds_min;
+		quantization.PositionScale = SafeQuantizationScale(bounds_max - bounds_min);
+		return quantization;
+	}
+
+	static void Pack(const Vertex& vertex, const VertexQuantization& quantization, unsigned char* out) {
+		glm::vec3 normalized = (vertex.Position - quantization.PositionOffset) / quantization.PositionScale;
+		unsigned short packed[4] = {
+			glm::packUnorm1x16(normalized.x),
+			glm::packUnorm1x16(normalized.y),
+			glm::packUnorm1x16(normalized.z),
+			0
+		};
+		std::memcpy(out, packed, Size);
+	}
+};
+
+struct Float3Normal {
+	static const GLint Components = 3;
+	static const GLenum Type = GL_FLOAT;
+	static const GLboolean Normalized = GL_FALSE;
+	static const unsigned int Size = 3 * sizeof(float);
+	static const bool IsOctahedral = false;
+
+	static void Pack(const Vertex& vertex, const VertexQuantization&, unsigned char* out) {
+		std::memcpy(out, &vertex.Normal, Size);
+	}
+};
+
+struct OctahedralNormal {
+	static const GLint Components = 2;
+	static const GLenum Type = GL_SHORT;
+	static const GLboolean Normalized = GL_TRUE;
+	static const unsigned int Size = 2 * sizeof(short);
+	static const bool IsOctahedral = true;
+
+	static void Pack(const Vertex& vertex, const VertexQuantization&, unsigned char* out) {
+		// meshes without normals come in as zero vectors
+		glm::vec2 encoded = glm::vec2(0.0f);
+		if (glm::dot(vertex.Normal, vertex.Normal) > 0.0f) {
+			encoded = EncodeOctahedral(glm::normalize(vertex.Normal));
+		}
+		unsigned short packed[2] = { glm::packSnorm1x16(encoded.x), glm::packSnorm1x16(encoded.y) };
+		std::memcpy(out, packed, Size);
+	}
+};
+
+struct Float2TextureCoordinates {
+	static const GLint Components = 2;
+	static const GLenum Type = GL_FLOAT;
+	static const GLboolean Normalized = GL_FALSE;
+	static const unsigned int Size = 2 * sizeof(float);
+
+	static void Pack(const Vertex& vertex, const VertexQuantization&, unsigned char* out) {
+		std::memcpy(out, &vertex.TextureCoordinates, Size);
+	}
+};
+
+// half floats instead of unorm16 so tiled (> 1) coordinates survive
+struct Half2TextureCoordinates {
+	static const GLint Components = 2;
+	static const GLenum Type = GL_HALF_FLOAT;
+	static const GLboolean Normalized = GL_FALSE;
+	static const unsigned int Size = 2 * sizeof(unsigned short);
+
+	static void Pack(const Vertex& vertex, const VertexQuantization&, unsigned char* out) {
+		unsigned short packed[2] = { glm::packHalf1x16(vertex.TextureCoordinates.x), glm::packHalf1x16(vertex.TextureCoordinates.y) };
+		std::memcpy(out, packed, Size);
+	}
+};
+
+// Interleaved layout built from three attribute encodings. Offsets, stride and the
+// glVertexAttribPointer calls all come from the attribute types at compile time.
+template <typename PositionAttribute, typename NormalAttribute, typename TextureCoordinatesAttribute>
+struct VertexLayout {
+	static const unsigned int PositionOffset = 0;
+	static const unsigned int NormalOffset = PositionOffset + PositionAttribute::Size;
+	static const unsigned int TextureCoordinatesOffset = NormalOffset + NormalAttribute::Size;
+	static const unsigned int Stride = TextureCoordinatesOffset + TextureCoordinatesAttribute::Size;
+	static const bool IsOctahedral = NormalAttribute::IsOctahedral;
+
+	static_assert(Stride % 4 == 0, "vertex stride has to stay 4 byte aligned");
+
+	static VertexQuantization ComputeQuantization(glm::vec3 bounds_min, glm::vec3 bounds_max) {
+		return PositionAttribute::ComputeQuantization(bounds_min, bounds_max);
+	}
+
+	// expects the vertex buffer to be bound to GL_ARRAY_BUFFER
+	static void SetupAttributes() {
+		SetupAttribute<PositionAttribute>(0, PositionOffset);
+		SetupAttribute<NormalAttribute>(1, NormalOffset);
+		SetupAttribute<TextureCoordinatesAttribute>(2, TextureCoordinatesOffset);
+	}
+
+	static std::vector<unsigned char> Pack(const std::vector<Vertex>& vertices, const VertexQuantization& quantization) {
+		std::vector<unsigned char> packed(vertices.size() * Stride);
+		unsigned char* out = packed.data();
+		for (const Vertex& vertex : vertices) {
+			PositionAttribute::Pack(vertex, quantization, out + PositionOffset);
+			NormalAttribute::Pack(vertex, quantization, out + NormalOffset);
+			TextureCoordinatesAttribute::Pack(vertex, quantization, out + TextureCoordinatesOffset);
+			out += Stride;
+		}
+		return packed;
+	}
+
+private:
+	template <typename Attribute>
+	static void SetupAttribute(GLuint location, unsigned int offset) {
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, Attribute::Components, Attribute::Type, Attribute::Normalized, Stride, (void*)(size_t)offset);
+	}
+};
+
+typedef VertexLayout<Float3Position, Float3Normal, Float2TextureCoordinates> FullVertexLayout;
+typedef VertexLayout<Half4Position, OctahedralNormal, Half2TextureCoordinates> HalfFloatVertexLayout;
+typedef VertexLayout<Unorm16Position, OctahedralNormal, Half2TextureCoordinates> QuantizedVertexLayout;
+
+static_assert(FullVertexLayout::Stride == sizeof(Vertex), "the full layout has to match Vertex");
+static_assert(HalfFloatVertexLayout::Stride == 16, "the half float layout should be half of Vertex");
+static_assert(QuantizedVertexLayout::Stride == 16, "the quantized layout should be half of Vertex");
+
+// runtime dispatch for code that only knows the format, e.g. a vertex array shared by many meshes
+inline unsigned int GetVertexStride(VertexFormat format) {
+	switch (format) {
+	case VertexFormat::HalfFloat:
+		return HalfFloatVertexLayout::Stride;
+	case VertexFormat::Quantized:
+		return QuantizedVertexLayout::Stride;
+	default:
+		return FullVertexLayout::Stride;
+	}
+}
+
+inline void SetupVertexAttributes(VertexFormat format) {
+	switch (format) {
+	case VertexFormat::HalfFloat:
+		HalfFloatVertexLayout::SetupAttributes();
+		break;
+	case VertexFormat::Quantized:
+		QuantizedVertexLayout::SetupAttributes();
+		break;
+	default:
+		FullVertexLayout::SetupAttributes();
+		break;
+	}
+}
@@ -7,10 +7,24 @@
 #include <iostream>
 #include <cstdlib>
 #include <ctime>
+#include <chrono>
 
 #include "Shader.h"
+#include "ShaderBatch.h"
+#include "ShaderPermutations.h"
 #include "Model.h"
+#include "ModelStreamer.h"
+#include "ProgramCache.h"
+#include "TextureCache.h"
+#include "TextureCooker.h"
 #include "Terrain.h"
+#include "MemoryStats.h"
+#include "GpuTimer.h"
+#include "GeometryArena.h"
+#include "InstanceBuffer.h"
+#include "FrameUniformBuffer.h"
+#include "TransformBuffer.h"
+#include "UploadRing.h"
 #include <stb_image/stb_image.h>
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
@@ -20,7 +34,7 @@ extern "C" {
 	_declspec(dllexport) unsigned long NvOptimusEnablement = 0x00000001;
 }
 
-void draw_model(Model model, Shader shader, glm::vec3 camera_position, glm::mat4 m_model, glm::mat4 m_view, glm::mat4 m_projection);
+void draw_model(const Model& model, Shader& shader, TransformBuffer& transforms, glm::vec3 camera_position, glm::mat4 m_model, glm::mat4 m_view, glm::mat4 m_projection);
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
@@ -30,7 +44,18 @@ void mouse_position_callback(GLFWwindow* window, double x_position, double y_pos
 
 void render_debug_menu();
 
-void render_light_source(Shader shader, glm::mat4 model, glm::mat4 view, glm::mat4 projection, glm::vec3 color);
+void render_light_source(Shader& shader, TransformBuffer& transforms, glm::mat4 model, glm::mat4 view, glm::mat4 projection, glm::vec3 color);
+
+void run_meshlet_benchmark(const Model& model, const glm::mat4& model_matrix, const glm::mat4& projection);
+
+void update_lod_benchmark();
+
+void draw_stress_scene(const Model& model, Shader& shader, Shader& instanced_shader, InstanceBuffer& instances, TransformBuffer& transforms,
+	const std::vector<glm::mat4>& model_matrices, const glm::mat4& view_projection, bool upload);
+
+void record_lod_benchmark();
+
+void run_scene(GLFWwindow* window);
 
 // Global variables (that will be moved to separate class)
 
@@ -121,6 +146,12 @@ float bloom_intensity_threshold = 0.6f;
 int shadows_enabled = 1;
 int specular_enabled = 1;
 
+// feature bits of the deferred and bloom shader variants, in the order their defines are given
+const uint32_t DEFERRED_SHADOWS = 1 << 0;
+const uint32_t DEFERRED_SPECULAR = 1 << 1;
+const uint32_t DEFERRED_DEBUG_VIEW = 1 << 2;
+const uint32_t BLOOM_ENABLED = 1 << 0;
+
 // shadow map variables
 float sm_frustum_size = 50.0f;
 float sm_near_plane = 1.0f;
@@ -129,6 +160,81 @@ float sm_far_plane = 100.0f;
 // debug variables
 bool is_renderdoc = false;
 
+// vertex format of the scene models, switch it to compare g-pass timings and VRAM between layouts
+const VertexFormat scene_vertex_format = VertexFormat::Quantized;
+// scene models share one geometry arena and batch their draws, switch it off to compare submit times
+const bool use_scene_geometry_arena = true;
+// textures are block compressed and cached next to their source on first load, switch it off to compare VRAM and load times
+const bool use_compressed_textures = true;
+// shader compiles are all issued before any status is checked, switch it off to compare startup times
+const bool use_parallel_shader_compile = true;
+
+// gpu timings and scene geometry size shown in the debug menu
+double shadow_pass_ms = 0.0;
+double g_pass_ms = 0.0;
+// GPU time of the g-pass vertex stage alone, measured with a second rasterizer discard submission
+bool vertex_stage_timing_enabled = false;
+double vertex_stage_ms = 0.0;
+// cpu time spent issuing the draws of each pass
+double shadow_pass_cpu_ms = 0.0;
+double g_pass_cpu_ms = 0.0;
+size_t scene_geometry_gpu_bytes = 0;
+size_t scene_index_bytes_saved = 0;
+size_t scene_arena_used_bytes = 0;
+size_t scene_arena_capacity_bytes = 0;
+// models upload in the frame loop, a slice of each frame at most
+float model_upload_budget_ms = 2.0f;
+// geometry and pixels the staging ring copies to the GPU per frame, whatever the models queue
+float staging_budget_mb = 4.0f;
+size_t staging_queued_bytes = 0;
+size_t staging_staged_bytes = 0;
+size_t models_streaming = 0;
+bool is_first_frame_reported = false;
+bool are_shaders_ready_reported = false;
+bool is_indirect_draw_supported = false;
+bool indirect_draw_enabled = true;
+
+// frustum culling results of the last frame
+CullingStats shadow_culling_stats;
+CullingStats g_pass_culling_stats;
+
+// meshlet culling switches, cone culling is off by default since faces are not culled and single sided geometry
+// can be seen from behind
+bool meshlet_culling_enabled = true;
+bool cone_culling_enabled = false;
+bool is_meshlet_benchmark_requested = false;
+// converts sponza again on 1 to N threads and prints the timings
+bool is_import_benchmark_requested = false;
+// loads the textures of sponza and the nanosuit uncompressed and cooked and prints VRAM and time of both
+bool is_texture_benchmark_requested = false;
+
+// state changes of the last frame's render queue flushes
+RenderStats shadow_render_stats;
+RenderStats g_pass_render_stats;
+bool render_queue_sorting_enabled = true;
+// glUniform calls of the last frame, every shader together
+UniformStats frame_uniform_stats;
+
+// LOD selection, the shadow pass accepts a larger error so it can use coarser levels than the g-pass
+bool lod_selection_enabled = true;
+float g_pass_lod_error_pixels = 1.0f;
+float shadow_lod_error_pixels = 4.0f;
+
+// fly-away LOD benchmark: LOD_BENCHMARK_FRAMES frames along the path with LODs off, then the same with LODs on
+const int LOD_BENCHMARK_FRAMES = 300;
+int lod_benchmark_frame = -1;
+double lod_benchmark_frame_ms = 0.0;
+double lod_benchmark_triangles = 0.0;
+
+// stress scene of STRESS_SCENE_SIZE * STRESS_SCENE_SIZE houses, drawn instanced or with one draw per house to compare CPU submit time
+const int STRESS_SCENE_SIZE = 100;
+bool stress_scene_enabled = false;
+bool stress_scene_instanced = true;
+double stress_scene_cpu_ms = 0.0;
+
+// allocations made by the render passes of the last frame, should stay at 0 once the scene is loaded
+size_t frame_allocation_count = 0;
+
 int main() {
 	if (is_renderdoc) {
 		std::cout << "press any key to start" << std::endl;
@@ -174,34 +280,94 @@ int main() {
 	glfwSetCursorPosCallback(window, mouse_position_callback);
 	glfwSetCursorPos(window, mouse_last_x, mouse_last_y);
 
-	/*Shader g_pass_terrain_shaders{ "Data/Shaders/v_g_pass_terrain.glsl", "Data/Shaders/f_g_pass_terrain.glsl" };
-	Shader g_pass_single_texture_terrain_shaders{ "Data/Shaders/v_g_pass_single_texture_terrain.glsl", "Data/Shaders/f_g_pass_single_texture_terrain.glsl" };*/
-	Shader sky_shaders = { "Data/Shaders/Sky/v_sky.glsl", "Data/Shaders/Sky/f_sky.glsl" };
-	Shader g_pass_shaders{ "Data/Shaders/v_g_pass.glsl", "Data/Shaders/f_g_pass.glsl" };
-	Shader deferred_shaders{ "Data/Shaders/v_deferred_render.glsl", "Data/Shaders/f_deferred_render.glsl" };
-	Shader light_source_shaders = { "Data/Shaders/v_light_source.glsl", "Data/Shaders/f_light_source.glsl" };
+	run_scene(window);
 
-	Shader simple_depth_shaders = { "Data/Shaders/v_simple_depth.glsl", "Data/Shaders/f_simple_depth.glsl" };
-	Shader debug_depth_quad_shaders = { "Data/Shaders/v_debug_depth_quad.glsl", "Data/Shaders/f_debug_depth_quad.glsl" };
+	ImGui_ImplOpenGL3_Shutdown();
+	ImGui_ImplGlfw_Shutdown();
+	ImGui::DestroyContext();
 
-	Shader billboard_shaders = { "Data/Shaders/v_billboard.glsl", "Data/Shaders/f_billboard.glsl" };
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return 0;
+}
 
-	Shader hdr_shaders = { "Data/Shaders/v_hdr.glsl", "Data/Shaders/f_hdr.glsl" };
-	Shader bloom_shaders = { "Data/Shaders/v_bloom.glsl", "Data/Shaders/f_bloom.glsl" };
-	Shader blur_shaders = { "Data/Shaders/v_blur.glsl", "Data/Shaders/f_blur.glsl" };
+// everything owning GL objects is a local here, so it is all destroyed before main tears down the context
+void run_scene(GLFWwindow* window) {
+	/*Shader g_pass_terrain_shaders{ "Data/Shaders/v_g_pass_terrain.glsl", "Data/Shaders/f_g_pass_terrain.glsl" };
+	Shader g_pass_single_texture_terrain_shaders{ "Data/Shaders/v_g_pass_single_texture_terrain.glsl", "Data/Shaders/f_g_pass_single_texture_terrain.glsl" };*/
+	ShaderBatch shader_batch(use_parallel_shader_compile);
+	Shader sky_shaders = { "Data/Shaders/Sky/v_sky.glsl", "Data/Shaders/Sky/f_sky.glsl", shader_batch };
+	Shader g_pass_shaders{ "Data/Shaders/v_g_pass.glsl", "Data/Shaders/f_g_pass.glsl", shader_batch };
+	Shader g_pass_instanced_shaders{ "Data/Shaders/v_g_pass_instanced.glsl", "Data/Shaders/f_g_pass.glsl", shader_batch };
+	ShaderPermutations deferred_permutations{ "Data/Shaders/v_deferred_render.glsl", "Data/Shaders/f_deferred_render.glsl",
+		{ "SHADOWS", "SPECULAR", "DEBUG_VIEW" } };
+	Shader light_source_shaders = { "Data/Shaders/v_light_source.glsl", "Data/Shaders/f_light_source.glsl", shader_batch };
+
+	Shader simple_depth_shaders = { "Data/Shaders/v_simple_depth.glsl", "Data/Shaders/f_simple_depth.glsl", shader_batch };
+	Shader simple_depth_instanced_shaders = { "Data/Shaders/v_simple_depth_instanced.glsl", "Data/Shaders/f_simple_depth.glsl", shader_batch };
+	Shader debug_depth_quad_shaders = { "Data/Shaders/v_debug_depth_quad.glsl", "Data/Shaders/f_debug_depth_quad.glsl", shader_batch };
+
+	Shader billboard_shaders = { "Data/Shaders/v_billboard.glsl", "Data/Shaders/f_billboard.glsl", shader_batch };
+
+	Shader hdr_shaders = { "Data/Shaders/v_hdr.glsl", "Data/Shaders/f_hdr.glsl", shader_batch };
+	ShaderPermutations bloom_permutations{ "Data/Shaders/v_bloom.glsl", "Data/Shaders/f_bloom.glsl", { "BLOOM" } };
+	Shader blur_shaders = { "Data/Shaders/v_blur.glsl", "Data/Shaders/f_blur.glsl", shader_batch };
+
+	// the default settings' variants up front, the others are built when the debug menu first asks for them
+	deferred_permutations.Prepare(DEFERRED_SHADOWS | DEFERRED_SPECULAR, shader_batch);
+	bloom_permutations.Prepare(BLOOM_ENABLED, shader_batch);
+
+	// the rest of startup runs while the driver compiles, each program is finished by the batch or its first use
+	ShaderLoadStats shader_load_stats = Shader::GetLoadStats();
+	std::cout << "STARTUP shaders: " << shader_load_stats.Programs << " programs in " << shader_load_stats.Milliseconds << " ms, "
+		<< shader_load_stats.CachedPrograms << " from the program cache" << (ProgramCache::IsSupported() ? "" : " (not supported)") << ", "
+		<< shader_batch.GetPendingCount() << " still compiling"
+		<< (!use_parallel_shader_compile ? " (batch off)" : ShaderBatch::IsParallelCompileSupported() ? " (parallel compile)" : " (no parallel compile)")
+		<< std::endl;
 
 	// Set callback function for window / frame size change so the viewport gets resized
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	
-	Model sponza_model("Data/Models/Sponza/sponza.obj");
-	Model sun_model("Data/Models/Sun/sun.obj");
-	Model sivir_model("Data/Models/Sivir/sivir.obj");
-	Model janna_model("Data/Models/Janna/janna.obj");
-	Model med_house_model("Data/Models/MedievalHouse/medieval_house.obj");
+	TextureCooker::SetEnabled(use_compressed_textures && glfwExtensionSupported("GL_EXT_texture_compression_s3tc"));
+
+	// sized for sponza and the characters, grows by doubling if a bigger scene is loaded
+	GeometryArena scene_geometry_arena(scene_vertex_format, 512 * 1024, 2 * 1024 * 1024);
+	is_indirect_draw_supported = scene_geometry_arena.IsIndirectSupported();
+
+	// streamed models queue their buffers and textures here instead of copying them the frame they arrive
+	UploadRing upload_ring(8 * 1024 * 1024, 3);
+
+	// nothing reads the geometry back on the CPU, so it is dropped once it is on the GPU
+	MeshOptions scene_mesh_options;
+	scene_mesh_options.Residency = GeometryResidency::DropAfterUpload;
+	scene_mesh_options.Format = scene_vertex_format;
+	scene_mesh_options.Optimize = true;
+	scene_mesh_options.MeshletTriangles = 96;
+	scene_mesh_options.LodCount = 3;
+	if (use_scene_geometry_arena) {
+		scene_mesh_options.Arena = &scene_geometry_arena;
+	}
+	scene_mesh_options.Staging = &upload_ring;
+
+	// streamed in while the frame loop runs, each model shows up once it is resident
+	Model sponza_model("Data/Models/Sponza/sponza.obj", false, scene_mesh_options);
+	Model sun_model("Data/Models/Sun/sun.obj", false, scene_mesh_options);
+	Model sivir_model("Data/Models/Sivir/sivir.obj", false, scene_mesh_options);
+	Model janna_model("Data/Models/Janna/janna.obj", false, scene_mesh_options);
+	Model med_house_model("Data/Models/MedievalHouse/medieval_house.obj", false, scene_mesh_options);
 	/*Model evelynn_model("Data/Models/Evelynn/evelynn.obj");
 	Model house_model("Data/Models/House/house.obj");*/
 
-	Model skydome_model("Data/Models/Dome/dome2.obj");
+	Model skydome_model("Data/Models/Dome/dome2.obj", false, scene_mesh_options);
+
+	ModelStreamer model_streamer(model_upload_budget_ms);
+	model_streamer.Load(skydome_model);
+	model_streamer.Load(sun_model);
+	model_streamer.Load(sponza_model);
+	model_streamer.Load(sivir_model);
+	model_streamer.Load(janna_model);
+	model_streamer.Load(med_house_model);
+	models_streaming = model_streamer.GetPendingCount();
 
 	/*Terrain main_terrain(100,
 		"Data/Textures/levels/heightmap2.png", 
@@ -209,12 +375,12 @@ int main() {
 		"Data/Textures/terrain/sand.jpg", 
 		"Data/Textures/terrain/grass.jpg", 
 		"Data/Textures/terrain/rock.jpg");
-	Model terrain_model = main_terrain.GetModel();*/
+	Model& terrain_model = main_terrain.GetModel();*/
 
 	/*Terrain grand_canyon_terrain(25,
 		"Data/Textures/levels/gcanyon_heightmap.png",
 		"Data/Textures/levels/gcanyon_texturemap.png");
-	Model terrain_model = grand_canyon_terrain.GetModel();*/
+	Model& terrain_model = grand_canyon_terrain.GetModel();*/
 
 	unsigned int gBuffer;
 	glGenFramebuffers(1, &gBuffer);
@@ -287,12 +453,6 @@ int main() {
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-	deferred_shaders.Use();
-	deferred_shaders.SetInt("gPosition", 0);
-	deferred_shaders.SetInt("gNormal", 1);
-	deferred_shaders.SetInt("gAlbedoSpec", 2);
-	deferred_shaders.SetInt("gDepth", 3);
-	deferred_shaders.SetInt("shadowMap", 4);
 	
 	unsigned int quad_vao = 0;
 	unsigned int quad_vbo;
@@ -351,8 +511,34 @@ int main() {
 		}
 	}
 
+	// camera and lights of the frame, written once and read by every program through the FrameData and LightData blocks
+	FrameUniformBuffer frame_uniforms;
+
+	GpuTimer shadow_pass_timer;
+	GpuTimer g_pass_timer;
+	GpuTimer vertex_stage_timer;
+
+	// the shadow pass and g-pass submit their visible meshes here and flush once per pass
+	RenderQueue render_queue;
+
+	glm::mat4 sponza_model_matrix = glm::mat4(1.0f);
+	sponza_model_matrix = glm::scale(sponza_model_matrix, glm::vec3(0.01f, 0.01f, 0.01f));
+	sponza_model_matrix = glm::rotate(sponza_model_matrix, glm::radians(90.0f), glm::vec3(0.0, 1.0, 0.0));
+
+	// houses on a grid around the origin, placed once the house is resident
+	std::vector<glm::mat4> stress_scene_matrices;
+	stress_scene_matrices.reserve(STRESS_SCENE_SIZE * STRESS_SCENE_SIZE);
+	const float stress_scene_scale = 0.2f;
+	InstanceBuffer stress_scene_instances(STRESS_SCENE_SIZE * STRESS_SCENE_SIZE);
+	TransformBuffer stress_scene_transforms;
+
+	// object transforms of draws outside the render queue
+	TransformBuffer object_transforms;
+
 	// Draw loop
 	while (!glfwWindowShouldClose(window)) {
+		size_t frame_allocation_start = MemoryStats::GetAllocationCount();
+
 		float current_frame_time = glfwGetTime();
 		delta_time = current_frame_time - last_frame_time;
 		last_frame_time = current_frame_time;
@@ -365,6 +551,48 @@ int main() {
 			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 		}
 
+		update_lod_benchmark();
+
+		if (models_streaming > 0) {
+			model_streamer.SetUploadBudget(model_upload_budget_ms);
+			model_streamer.Update();
+			models_streaming = model_streamer.GetPendingCount();
+			if (models_streaming == 0) {
+				TextureCache::GetShared().PrintReport();
+			}
+
+			scene_geometry_gpu_bytes = sponza_model.GetGpuBytes() + sun_model.GetGpuBytes() + sivir_model.GetGpuBytes() +
+				janna_model.GetGpuBytes() + med_house_model.GetGpuBytes() + skydome_model.GetGpuBytes();
+			scene_index_bytes_saved = sponza_model.GetIndexBytesSaved() + sun_model.GetIndexBytesSaved() + sivir_model.GetIndexBytesSaved() +
+				janna_model.GetIndexBytesSaved() + med_house_model.GetIndexBytesSaved() + skydome_model.GetIndexBytesSaved();
+			scene_arena_used_bytes = scene_geometry_arena.GetUsedBytes();
+			scene_arena_capacity_bytes = scene_geometry_arena.GetCapacityBytes();
+		}
+
+		upload_ring.Update((size_t)(staging_budget_mb * 1024.0f * 1024.0f));
+		staging_queued_bytes = upload_ring.GetQueuedBytes();
+		staging_staged_bytes = upload_ring.GetStagedBytes();
+
+		shader_batch.Update();
+		if (!are_shaders_ready_reported && shader_batch.GetPendingCount() == 0) {
+			std::cout << "STARTUP shaders ready: " << glfwGetTime() * 1000.0 << " ms after start, " << Shader::GetLoadStats().Milliseconds
+				<< " ms of it on the main thread" << std::endl;
+			are_shaders_ready_reported = true;
+		}
+
+		// spaced by the house's scaled bounds so they do not overlap
+		if (stress_scene_matrices.empty() && med_house_model.IsResident()) {
+			const BoundingBox& house_box = med_house_model.GetBounds().Box;
+			float stress_scene_spacing = glm::max(house_box.Max.x - house_box.Min.x, house_box.Max.z - house_box.Min.z) * stress_scene_scale * 1.25f;
+			for (int x = 0; x < STRESS_SCENE_SIZE; x++) {
+				for (int z = 0; z < STRESS_SCENE_SIZE; z++) {
+					glm::vec3 position = glm::vec3(x - STRESS_SCENE_SIZE / 2, 0.0f, z - STRESS_SCENE_SIZE / 2) * stress_scene_spacing;
+					glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+					stress_scene_matrices.push_back(glm::scale(model, glm::vec3(stress_scene_scale)));
+				}
+			}
+		}
+
 		glm::mat4 view;
 		view = glm::lookAt(camera_position, camera_position + camera_front, camera_up);
 
@@ -377,19 +605,67 @@ int main() {
 		glm::mat4 lightProjection = glm::ortho(-sm_frustum_size, sm_frustum_size, -sm_frustum_size, sm_frustum_size, sm_near_plane, sm_far_plane);
 		glm::mat4 lightView = glm::lookAt(directional_light_direction, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 		glm::mat4 lightSpaceMatrix = lightProjection * lightView;
-		simple_depth_shaders.Use();
-		simple_depth_shaders.SetMatrix4("lightSpaceMatrix", lightSpaceMatrix);
+
+		frame_uniforms.SetCamera(view, projection, camera_position);
+		frame_uniforms.SetLightSpace(lightSpaceMatrix);
+		frame_uniforms.SetDirectionalLight(directional_light_direction, directional_light_ambient, directional_light_diffuse, directional_light_specular);
+		for (unsigned int i = 0; i < lightPositions.size() && i < FrameUniformBuffer::MAX_POINT_LIGHTS; i++) {
+			const float constant = 1.0;
+			const float maxBrightness = std::fmaxf(std::fmaxf(lightColors[i].r, lightColors[i].g), lightColors[i].b);
+			float radius = (-point_light_linear + std::sqrt(point_light_linear * point_light_linear - 4 * point_light_quadratic *
+				(constant - (256.0f / 5.0f) * maxBrightness))) / (2.0f * point_light_quadratic);
+			frame_uniforms.SetPointLight(i, lightPositions[i], lightColors[i], point_light_linear, point_light_quadratic, radius);
+		}
+		frame_uniforms.Upload();
+
+		// the shadow pass culls against the light's ortho frustum, the g-pass against the camera.
+		// cone culling needs a view position, which the directional light does not have
+		DrawView light_view;
+		light_view.ViewFrustum = Frustum(lightSpaceMatrix);
+		light_view.MeshletCulling = meshlet_culling_enabled;
+		light_view.IsOrthographic = true;
+		light_view.LodPixelScale = lod_selection_enabled ? window_height / (2.0f * sm_frustum_size) : 0.0f;
+		light_view.LodErrorPixels = shadow_lod_error_pixels;
+		DrawView camera_view;
+		camera_view.ViewFrustum = Frustum(projection * view);
+		camera_view.Position = camera_position;
+		camera_view.MeshletCulling = meshlet_culling_enabled;
+		camera_view.ConeCulling = cone_culling_enabled;
+		camera_view.LodPixelScale = lod_selection_enabled ? window_height / (2.0f * glm::tan(glm::radians(45.0f) * 0.5f)) : 0.0f;
+		camera_view.LodErrorPixels = g_pass_lod_error_pixels;
+		shadow_culling_stats = CullingStats();
+		g_pass_culling_stats = CullingStats();
+		shadow_render_stats = RenderStats();
+		g_pass_render_stats = RenderStats();
+		scene_geometry_arena.SetIndirectEnabled(indirect_draw_enabled);
+		render_queue.SetSortingEnabled(render_queue_sorting_enabled);
+
+		if (is_meshlet_benchmark_requested) {
+			run_meshlet_benchmark(sponza_model, sponza_model_matrix, projection);
+			is_meshlet_benchmark_requested = false;
+		}
+		if (is_import_benchmark_requested) {
+			Model::MeasureImportScaling("Data/Models/Sponza/sponza.obj", scene_mesh_options);
+			is_import_benchmark_requested = false;
+		}
+		if (is_texture_benchmark_requested) {
+			Model::MeasureTextureCompression("Data/Models/Sponza/sponza.obj");
+			Model::MeasureTextureCompression("Data/Models/Nanosuit/nanosuit.obj");
+			is_texture_benchmark_requested = false;
+		}
 
 		glBindFramebuffer(GL_FRAMEBUFFER, directional_light_depth_fbo);
 		glClear(GL_DEPTH_BUFFER_BIT);
 		glActiveTexture(GL_TEXTURE0);
 
+		shadow_pass_timer.Begin();
+		std::chrono::steady_clock::time_point shadow_pass_start = std::chrono::steady_clock::now();
+
 		// draw janna
 		{
 			glm::mat4 model = glm::mat4(1.0f);
 			model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-			simple_depth_shaders.SetMatrix4("model", model);
-			janna_model.Draw(simple_depth_shaders);
+			janna_model.Submit(render_queue, simple_depth_shaders, model, light_view, shadow_culling_stats);
 		}
 
 		// draw house
@@ -397,19 +673,26 @@ int main() {
 		{
 			glm::mat4 model = glm::mat4(1.0f);
 			model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));
-			simple_depth_shaders.SetMatrix4("model", model);
-			med_house_model.Draw(simple_depth_shaders);
+			med_house_model.Submit(render_queue, simple_depth_shaders, model, light_view, shadow_culling_stats);
 		}
 
 		// draw sponza
-		{
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::scale(model, glm::vec3(0.01f, 0.01f, 0.01f));
-			model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0, 1.0, 0.0));
-			simple_depth_shaders.SetMatrix4("model", model);
-			sponza_model.Draw(simple_depth_shaders);
+		sponza_model.Submit(render_queue, simple_depth_shaders, sponza_model_matrix, light_view, shadow_culling_stats);
+
+		render_queue.Flush(shadow_render_stats, lightSpaceMatrix);
+
+		stress_scene_cpu_ms = 0.0;
+		if (stress_scene_enabled && !stress_scene_matrices.empty()) {
+			simple_depth_instanced_shaders.Use();
+			// the instances are uploaded once here and reused by the g-pass
+			draw_stress_scene(med_house_model, simple_depth_shaders, simple_depth_instanced_shaders, stress_scene_instances, stress_scene_transforms,
+				stress_scene_matrices, lightSpaceMatrix, true);
 		}
 
+		shadow_pass_cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shadow_pass_start).count();
+		shadow_pass_timer.End();
+		shadow_pass_ms = shadow_pass_timer.GetMilliseconds();
+
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -446,17 +729,15 @@ int main() {
 		else {
 			glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			g_pass_timer.Begin();
+			std::chrono::steady_clock::time_point g_pass_start = std::chrono::steady_clock::now();
 			glm::mat4 model = glm::mat4(1.0f);
-			g_pass_shaders.Use();
-			g_pass_shaders.SetMatrix4("projection", projection);
-			g_pass_shaders.SetMatrix4("view", view);
 
 			// draw janna
 			{
 				glm::mat4 model = glm::mat4(1.0f);
 				model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-				g_pass_shaders.SetMatrix4("model", model);
-				janna_model.Draw(g_pass_shaders);
+				janna_model.Submit(render_queue, g_pass_shaders, model, camera_view, g_pass_culling_stats);
 			}
 
 			// draw house
@@ -464,22 +745,44 @@ int main() {
 			{
 				glm::mat4 model = glm::mat4(1.0f);
 				model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));
-				g_pass_shaders.SetMatrix4("model", model);
-				med_house_model.Draw(g_pass_shaders);
+				med_house_model.Submit(render_queue, g_pass_shaders, model, camera_view, g_pass_culling_stats);
 			}
 
 			// draw sponza
-			{
-				glm::mat4 model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.01f, 0.01f, 0.01f));
-				model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0, 1.0, 0.0));
-				g_pass_shaders.SetMatrix4("model", model);
-				sponza_model.Draw(g_pass_shaders);
+			sponza_model.Submit(render_queue, g_pass_shaders, sponza_model_matrix, camera_view, g_pass_culling_stats);
+
+			render_queue.Flush(g_pass_render_stats, projection * view);
+
+			if (stress_scene_enabled && !stress_scene_matrices.empty()) {
+				g_pass_instanced_shaders.Use();
+				draw_stress_scene(med_house_model, g_pass_shaders, g_pass_instanced_shaders, stress_scene_instances, stress_scene_transforms,
+					stress_scene_matrices, projection * view, false);
+			}
+
+			g_pass_cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - g_pass_start).count();
+			g_pass_timer.End();
+			g_pass_ms = g_pass_timer.GetMilliseconds();
+
+			// the g-pass geometry again with rasterization off, so only the vertex stage is timed
+			if (vertex_stage_timing_enabled) {
+				CullingStats vertex_stage_culling_stats;
+				RenderStats vertex_stage_render_stats;
+				glEnable(GL_RASTERIZER_DISCARD);
+				vertex_stage_timer.Begin();
+				janna_model.Submit(render_queue, g_pass_shaders, glm::mat4(1.0f), camera_view, vertex_stage_culling_stats);
+				sponza_model.Submit(render_queue, g_pass_shaders, sponza_model_matrix, camera_view, vertex_stage_culling_stats);
+				render_queue.Flush(vertex_stage_render_stats, projection * view);
+				vertex_stage_timer.End();
+				glDisable(GL_RASTERIZER_DISCARD);
+				vertex_stage_ms = vertex_stage_timer.GetMilliseconds();
 			}
 
 			glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+			uint32_t deferred_features = (shadows_enabled ? DEFERRED_SHADOWS : 0) | (specular_enabled ? DEFERRED_SPECULAR : 0) |
+				(show_render_target != 0 ? DEFERRED_DEBUG_VIEW : 0);
+			Shader& deferred_shaders = deferred_permutations.Get(deferred_features);
 			deferred_shaders.Use();
 
 			glActiveTexture(GL_TEXTURE0);
@@ -493,30 +796,16 @@ int main() {
 			glActiveTexture(GL_TEXTURE4);
 			glBindTexture(GL_TEXTURE_2D, directional_light_depth_map);
 
-			for (unsigned int i = 0; i < lightPositions.size(); i++) {
-				deferred_shaders.SetVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-				deferred_shaders.SetVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
-				const float constant = 1.0;
-
-				deferred_shaders.SetFloat("lights[" + std::to_string(i) + "].Linear", point_light_linear);
-				deferred_shaders.SetFloat("lights[" + std::to_string(i) + "].Quadratic", point_light_quadratic);
-				const float maxBrightness = std::fmaxf(std::fmaxf(lightColors[i].r, lightColors[i].g), lightColors[i].b);
-				float radius = (-point_light_linear + std::sqrt(point_light_linear * point_light_linear - 4 * point_light_quadratic *
-					(constant - (256.0f / 5.0f) * maxBrightness))) / (2.0f * point_light_quadratic);
-				deferred_shaders.SetFloat("lights[" + std::to_string(i) + "].Radius", radius);
-			}
-
-			deferred_shaders.SetVec3("directional_light.direction", directional_light_direction);
-			deferred_shaders.SetVec3("directional_light.ambient", directional_light_ambient);
-			deferred_shaders.SetVec3("directional_light.diffuse", directional_light_diffuse);
-			deferred_shaders.SetVec3("directional_light.specular", directional_light_specular);
-
-			deferred_shaders.SetVec3("viewPos", camera_position);
-			deferred_shaders.SetMatrix4("lightSpaceMatrix", lightSpaceMatrix);
-			deferred_shaders.SetInt("show_render_target", show_render_target);
+			// lights and camera come from the LightData and FrameData blocks, samplers are only sent once per variant
+			deferred_shaders.SetInt("gPosition", 0);
+			deferred_shaders.SetInt("gNormal", 1);
+			deferred_shaders.SetInt("gAlbedoSpec", 2);
+			deferred_shaders.SetInt("gDepth", 3);
+			deferred_shaders.SetInt("shadowMap", 4);
 			deferred_shaders.SetFloat("bloom_threshold", bloom_intensity_threshold);
-			deferred_shaders.SetInt("shadows_enabled", (int)shadows_enabled);
-			deferred_shaders.SetInt("specular_enabled", (int)specular_enabled);
+			if (deferred_features & DEFERRED_DEBUG_VIEW) {
+				deferred_shaders.SetInt("show_render_target", show_render_target);
+			}
 
 			if (quad_vao == 0)
 			{
@@ -551,7 +840,7 @@ int main() {
 				glm::mat4 model = glm::mat4(1.0);
 				model = glm::translate(model, lightPositions[i]);
 				model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));
-				render_light_source(light_source_shaders, model, view, projection, lightColors[i]);
+				render_light_source(light_source_shaders, object_transforms, model, view, projection, lightColors[i]);
 			}*/
 
 			// render skydome
@@ -559,9 +848,7 @@ int main() {
 				glm::mat4 model = glm::mat4(1.0f);
 				model = glm::scale(model, glm::vec3(250.0f, 250.0f, 250.0f));
 				sky_shaders.Use();
-				sky_shaders.SetMatrix4("model", model);
-				sky_shaders.SetMatrix4("view", view);
-				sky_shaders.SetMatrix4("projection", projection);
+				object_transforms.Set(model, projection * view);
 				sky_shaders.SetFloat("red_factor", red_factor);
 				sky_shaders.SetFloat("green_factor", green_factor);
 				sky_shaders.SetFloat("blue_factor", blue_factor);
@@ -579,9 +866,7 @@ int main() {
 				model = glm::translate(model, directional_light_direction);
 				model = glm::scale(model, glm::vec3(10.0f, 10.0f, 10.0f));
 
-				billboard_shaders.SetMatrix4("model", model);
-				billboard_shaders.SetMatrix4("view", view);
-				billboard_shaders.SetMatrix4("projection", projection);
+				object_transforms.Set(model, projection * view);
 
 				sun_model.Draw(billboard_shaders);
 			}
@@ -609,6 +894,7 @@ int main() {
 			// 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
 			// --------------------------------------------------------------------------------------------------------------------------
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			Shader& bloom_shaders = bloom_permutations.Get(is_bloom ? BLOOM_ENABLED : 0);
 			bloom_shaders.Use();
 			glActiveTexture(GL_TEXTURE0);
 			glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
@@ -616,43 +902,148 @@ int main() {
 			glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
 			bloom_shaders.SetInt("scene", 0);
 			bloom_shaders.SetInt("bloomBlur", 1);
-			bloom_shaders.SetInt("bloom", is_bloom);
 			bloom_shaders.SetFloat("exposure", hdr_exposure);
 			glBindVertexArray(quad_vao);
 			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 			glBindVertexArray(0);
 		}
 
+		// the debug menu is left out on purpose, imgui manages its own memory
+		frame_allocation_count = MemoryStats::GetAllocationCount() - frame_allocation_start;
+		frame_uniform_stats = Shader::GetUniformStats();
+		Shader::ResetUniformStats();
+
+		record_lod_benchmark();
+
 		if (show_debug_menu) {
 			render_debug_menu();
 		}
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
-	}
-
-	ImGui_ImplOpenGL3_Shutdown();
-	ImGui_ImplGlfw_Shutdown();
-	ImGui::DestroyContext();
 
-	glfwDestroyWindow(window);
-	glfwTerminate();
-	return 0;
+		if (!is_first_frame_reported) {
+			// the programs frame one did not use, their compiles have had the whole frame
+			shader_batch.Finish();
+			std::cout << "FIRST FRAME: " << glfwGetTime() * 1000.0 << " ms after start, " << Shader::GetLoadStats().Milliseconds
+				<< " ms of it shaders, " << models_streaming << " models streaming" << std::endl;
+			is_first_frame_reported = true;
+		}
+	}
 }
 
-void draw_model(Model model, Shader shader, glm::vec3 camera_position, glm::mat4 m_model, glm::mat4 m_view, glm::mat4 m_projection) {
+void draw_model(const Model& model, Shader& shader, TransformBuffer& transforms, glm::vec3 camera_position, glm::mat4 m_model, glm::mat4 m_view, glm::mat4 m_projection) {
 	shader.Use();
 
 	// Set material properties
 	shader.SetVec3("camera_position", camera_position);
 	shader.SetFloat("material.shininess", 32.0f);
 
-	shader.SetMatrix4("model", m_model);
-	shader.SetMatrix4("view", m_view);
-	shader.SetMatrix4("projection", m_projection);
+	transforms.Set(m_model, m_projection * m_view);
 	model.Draw(shader);
 }
 
+void run_meshlet_benchmark(const Model& model, const glm::mat4& model_matrix, const glm::mat4& projection) {
+	// camera positions and targets through sponza, in world space
+	const glm::vec3 views[][2] = {
+		{ glm::vec3(0.0f, 2.0f, 15.0f), glm::vec3(0.0f, 2.0f, -15.0f) },
+		{ glm::vec3(0.0f, 2.0f, -15.0f), glm::vec3(0.0f, 2.0f, 15.0f) },
+		{ glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(8.0f, 2.0f, 0.0f) },
+		{ glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(-8.0f, 4.0f, 0.0f) },
+		{ glm::vec3(-8.0f, 1.5f, 12.0f), glm::vec3(8.0f, 3.0f, -12.0f) },
+		{ glm::vec3(6.0f, 6.0f, 0.0f), glm::vec3(-6.0f, 2.0f, 0.0f) },
+		{ glm::vec3(0.0f, 12.0f, 0.0f), glm::vec3(0.0f, 0.0f, -6.0f) },
+	};
+
+	std::cout << "MESHLET BENCHMARK: " << model.GetTriangleCount() << " triangles, " << model.GetMeshletCount() << " meshlets" << std::endl;
+	for (const auto& camera : views) {
+		DrawView view;
+		view.ViewFrustum = Frustum(projection * glm::lookAt(camera[0], camera[1], glm::vec3(0.0f, 1.0f, 0.0f)));
+		view.Position = camera[0];
+
+		// whole meshes, then meshlets against the frustum, then meshlets against the frustum and their normal cones
+		CullingStats mesh_stats, meshlet_stats, cone_stats;
+		view.MeshletCulling = false;
+		model.Cull(model_matrix, view, mesh_stats);
+		view.MeshletCulling = true;
+		model.Cull(model_matrix, view, meshlet_stats);
+		view.ConeCulling = true;
+		model.Cull(model_matrix, view, cone_stats);
+
+		std::cout << "  from (" << camera[0].x << ", " << camera[0].y << ", " << camera[0].z << "): submitted "
+			<< mesh_stats.Triangles << " with mesh culling, " << meshlet_stats.Triangles << " with meshlet culling, "
+			<< cone_stats.Triangles << " front facing in view" << std::endl;
+	}
+}
+
+void draw_stress_scene(const Model& model, Shader& shader, Shader& instanced_shader, InstanceBuffer& instances, TransformBuffer& transforms,
+	const std::vector<glm::mat4>& model_matrices, const glm::mat4& view_projection, bool upload) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	if (stress_scene_instanced) {
+		if (upload) {
+			instances.Upload(model_matrices);
+		}
+		instanced_shader.Use();
+		model.DrawInstanced(instanced_shader, instances);
+	}
+	else {
+		shader.Use();
+		transforms.Upload(model_matrices, view_projection);
+		for (size_t i = 0; i < model_matrices.size(); i++) {
+			transforms.Bind(i);
+			model.Draw(shader);
+		}
+	}
+
+	stress_scene_cpu_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void update_lod_benchmark() {
+	if (lod_benchmark_frame < 0) {
+		return;
+	}
+
+	// away from the middle of sponza and up, always looking back at it
+	float t = (lod_benchmark_frame % LOD_BENCHMARK_FRAMES) / (float)(LOD_BENCHMARK_FRAMES - 1);
+	camera_position = glm::mix(glm::vec3(0.0f, 2.0f, 10.0f), glm::vec3(0.0f, 30.0f, 250.0f), t);
+	camera_front = glm::normalize(glm::vec3(0.0f, 2.0f, 0.0f) - camera_position);
+	lod_selection_enabled = lod_benchmark_frame >= LOD_BENCHMARK_FRAMES;
+}
+
+void record_lod_benchmark() {
+	if (lod_benchmark_frame < 0) {
+		return;
+	}
+
+	int frame = lod_benchmark_frame % LOD_BENCHMARK_FRAMES;
+	const char* mode = lod_selection_enabled ? "on" : "off";
+	unsigned int triangles = g_pass_culling_stats.Triangles + shadow_culling_stats.Triangles;
+	// delta_time is the length of the frame before this one
+	double frame_ms = delta_time * 1000.0;
+	lod_benchmark_frame_ms += frame_ms;
+	lod_benchmark_triangles += triangles;
+
+	if (frame % 30 == 0) {
+		std::cout << "LOD BENCHMARK lods " << mode << ", distance " << glm::length(camera_position - glm::vec3(0.0f, 2.0f, 0.0f))
+			<< ": g-pass " << g_pass_culling_stats.Triangles << " triangles, shadow " << shadow_culling_stats.Triangles
+			<< " triangles, frame " << frame_ms << " ms, g-pass GPU " << g_pass_ms << " ms" << std::endl;
+	}
+
+	if (frame == LOD_BENCHMARK_FRAMES - 1) {
+		std::cout << "LOD BENCHMARK lods " << mode << " average: " << lod_benchmark_triangles / LOD_BENCHMARK_FRAMES << " triangles, "
+			<< lod_benchmark_frame_ms / LOD_BENCHMARK_FRAMES << " ms per frame" << std::endl;
+		lod_benchmark_frame_ms = 0.0;
+		lod_benchmark_triangles = 0.0;
+	}
+
+	lod_benchmark_frame++;
+	if (lod_benchmark_frame == 2 * LOD_BENCHMARK_FRAMES) {
+		lod_benchmark_frame = -1;
+		lod_selection_enabled = true;
+	}
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 	glViewport(0, 0, width, height);
 }
@@ -749,6 +1140,61 @@ void render_debug_menu() {
 	if (ImGui::Begin("Render Variables", NULL, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoMove)) {
 		ImGui::Checkbox("Wireframe", &is_wireframe);
 
+		ImGui::Separator();
+		ImGui::Text("Frame Allocations: %zu", frame_allocation_count);
+		ImGui::Text("Shadow Pass: %.3f ms, CPU %.3f ms", shadow_pass_ms, shadow_pass_cpu_ms);
+		ImGui::Text("Shadow Draws: %u items, %u draw calls", shadow_render_stats.Items, shadow_render_stats.DrawCalls);
+		ImGui::Text("Shadow Binds: %u programs, %u textures, %u VAOs", shadow_render_stats.ProgramBinds, shadow_render_stats.TextureBinds, shadow_render_stats.VertexArrayBinds);
+		ImGui::Text("Shadow Meshes: %u drawn, %u culled", shadow_culling_stats.Drawn, shadow_culling_stats.Culled);
+		ImGui::Text("Shadow Triangles: %u, %u meshlets culled", shadow_culling_stats.Triangles, shadow_culling_stats.MeshletsCulled);
+		ImGui::Text("G-Pass: %.3f ms, CPU %.3f ms", g_pass_ms, g_pass_cpu_ms);
+		ImGui::Checkbox("Time G-Pass Vertex Stage", &vertex_stage_timing_enabled);
+		if (vertex_stage_timing_enabled) {
+			ImGui::Text("G-Pass Vertex Stage: %.3f ms", vertex_stage_ms);
+		}
+		ImGui::Text("G-Pass Draws: %u items, %u draw calls", g_pass_render_stats.Items, g_pass_render_stats.DrawCalls);
+		ImGui::Text("G-Pass Binds: %u programs, %u textures, %u VAOs", g_pass_render_stats.ProgramBinds, g_pass_render_stats.TextureBinds, g_pass_render_stats.VertexArrayBinds);
+		ImGui::Checkbox("Sort Render Queue", &render_queue_sorting_enabled);
+		ImGui::Text("Uniform Calls: %u, %u skipped as unchanged, %u by name", frame_uniform_stats.Calls, frame_uniform_stats.Skipped,
+			frame_uniform_stats.NameLookups);
+		ImGui::Text("G-Pass Meshes: %u drawn, %u culled", g_pass_culling_stats.Drawn, g_pass_culling_stats.Culled);
+		ImGui::Text("G-Pass Triangles: %u, %u meshlets culled", g_pass_culling_stats.Triangles, g_pass_culling_stats.MeshletsCulled);
+		ImGui::Checkbox("Meshlet Culling", &meshlet_culling_enabled);
+		ImGui::Checkbox("Cone Culling", &cone_culling_enabled);
+		if (ImGui::Button("Run Meshlet Benchmark")) {
+			is_meshlet_benchmark_requested = true;
+		}
+		if (ImGui::Button("Run Import Scaling Benchmark")) {
+			is_import_benchmark_requested = true;
+		}
+		if (ImGui::Button("Run Texture Compression Benchmark")) {
+			is_texture_benchmark_requested = true;
+		}
+		ImGui::Checkbox("LOD Selection", &lod_selection_enabled);
+		ImGui::DragFloat("G-Pass LOD Error (px)", &g_pass_lod_error_pixels, 0.1f, 0.0f, 16.0f);
+		ImGui::DragFloat("Shadow LOD Error (px)", &shadow_lod_error_pixels, 0.1f, 0.0f, 16.0f);
+		if (ImGui::Button("Run LOD Benchmark") && lod_benchmark_frame < 0) {
+			lod_benchmark_frame = 0;
+		}
+		ImGui::Text("Streaming: %u models pending", (unsigned int)models_streaming);
+		ImGui::DragFloat("Upload Budget (ms)", &model_upload_budget_ms, 0.1f, 0.1f, 16.0f);
+		ImGui::DragFloat("Staging Budget (MB)", &staging_budget_mb, 0.25f, 0.25f, 8.0f);
+		ImGui::Text("Staging: %.2f MB queued, %.2f MB this frame", staging_queued_bytes / (1024.0 * 1024.0),
+			staging_staged_bytes / (1024.0 * 1024.0));
+		ImGui::Text("Geometry VRAM: %.2f MB", scene_geometry_gpu_bytes / (1024.0 * 1024.0));
+		TextureCacheStats texture_stats = TextureCache::GetShared().GetStats();
+		ImGui::Text("Texture VRAM: %.2f MB in %u textures, %.2f MB saved", texture_stats.GpuBytes / (1024.0 * 1024.0),
+			(unsigned int)texture_stats.TextureCount, texture_stats.GpuBytesSaved / (1024.0 * 1024.0));
+		ImGui::Text("Texture Cache: %u hits, %u misses", texture_stats.Hits, texture_stats.Misses);
+		ImGui::Text("16 Bit Index Savings: %.2f MB", scene_index_bytes_saved / (1024.0 * 1024.0));
+		ImGui::Text("Geometry Arena: %.2f / %.2f MB", scene_arena_used_bytes / (1024.0 * 1024.0), scene_arena_capacity_bytes / (1024.0 * 1024.0));
+		if (is_indirect_draw_supported) {
+			ImGui::Checkbox("Indirect Draws", &indirect_draw_enabled);
+		}
+		ImGui::Checkbox("House Stress Scene", &stress_scene_enabled);
+		ImGui::Checkbox("Instanced Houses", &stress_scene_instanced);
+		ImGui::Text("Stress Scene Submit: CPU %.3f ms", stress_scene_cpu_ms);
+
 		ImGui::Separator();
 		ImGui::Checkbox("Show Shadow Map", &show_shadow_map);
 
@@ -770,6 +1216,9 @@ void render_debug_menu() {
 
 		ImGui::Separator();
 		ImGui::DragInt("Show Render Target", &show_render_target, 1.0f, 0, 4);
+		ShaderVariantStats variant_stats = ShaderPermutations::GetStats();
+		ImGui::Text("Shader Variants: %u built in %.1f ms, %u from the program cache", variant_stats.Variants, variant_stats.Milliseconds,
+			variant_stats.CachedVariants);
 
 		ImGui::Separator();
 		ImGui::DragFloat("Camera Speed", &base_camera_speed, 0.5f, 1.0f, 50.0f);
@@ -805,7 +1254,7 @@ void render_debug_menu() {
 
 unsigned int light_source_vao = 0;
 unsigned int light_source_vbo = 0;
-void render_light_source(Shader shader, glm::mat4 model, glm::mat4 view, glm::mat4 projection, glm::vec3 color) {
+void render_light_source(Shader& shader, TransformBuffer& transforms, glm::mat4 model, glm::mat4 view, glm::mat4 projection, glm::vec3 color) {
 	// initialize (if necessary)
 	if (light_source_vao == 0)
 	{
@@ -867,9 +1316,7 @@ void render_light_source(Shader shader, glm::mat4 model, glm::mat4 view, glm::ma
 	}
 
 	shader.Use();
-	shader.SetMatrix4("model", model);
-	shader.SetMatrix4("view", view);
-	shader.SetMatrix4("projection", projection);
+	transforms.Set(model, projection * view);
 	shader.SetVec3("light_color", color);
 
 	glBindVertexArray(light_source_vao);